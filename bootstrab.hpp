@@ -5,6 +5,11 @@
 #if defined(BSTB_IMPL) || defined(BSTB_RT)
 
 #include <utility>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <atomic>
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -22,10 +27,21 @@ extern "C" {
   #include <sys/mman.h>
   #include <sys/stat.h>
   #include <sys/wait.h>
+  #include <sys/resource.h>
+  #include <sys/file.h>
   #include <unistd.h>
   #include <fcntl.h>
   #include <dlfcn.h>
   #include <spawn.h>
+  #include <signal.h>
+  #include <errno.h>
+  #include <poll.h>
+  #include <stdio.h>
+  #include <stdlib.h>
+#if defined(__linux__)
+  #include <sys/epoll.h>
+  #include <sys/syscall.h>
+#endif
 }
 
 using CStr = char const*;
@@ -54,34 +70,252 @@ namespace sys::linux {
       return open(path, O_RDWR | O_CREAT, 0664);
     }
 
+    inline auto open_fd_append(CStr path) -> Fd {
+      return open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0664);
+    }
+
     inline auto get_fd_size(Fd fd) -> size_t {
       struct stat st;
       fstat(fd, &st);
       return st.st_size;
     }
 
+    struct FileInfo {
+      bool exists;
+      long long mtime;
+      unsigned long long size;
+    };
+
+    inline auto stat_path(CStr path) -> FileInfo {
+#if defined(__linux__) && defined(STATX_MTIME)
+      struct statx stx;
+      if (statx(AT_FDCWD, path, AT_STATX_SYNC_AS_STAT, STATX_MTIME | STATX_SIZE, &stx) != 0) {
+        return {};
+      }
+      return { true, stx.stx_mtime.tv_sec * 1000000000ll + stx.stx_mtime.tv_nsec, stx.stx_size };
+#else
+      struct stat st;
+      if (stat(path, &st) != 0) {
+        return {};
+      }
+      return { true, st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec, static_cast<unsigned long long>(st.st_size) };
+#endif
+    }
+
     inline auto fd_truncate(Fd fd, size_t size) -> int {
       return ftruncate(fd, size);
     }
 
-    inline auto map_fd_read(Fd fd, size_t size) -> void* {
-      auto* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0); 
+    enum {
+      MapNormal = MADV_NORMAL,
+      MapSequential = MADV_SEQUENTIAL,
+      MapRandom = MADV_RANDOM,
+      MapWillNeed = MADV_WILLNEED,
+    };
+
+    inline auto map_fd(Fd fd, size_t size, int prot, bool populate = false) -> void* {
+      auto flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+      if (populate) {
+        flags |= MAP_POPULATE;
+      }
+#else
+      (void)populate;
+#endif
+      auto* data = mmap(NULL, size, prot, flags, fd, 0);
       if (data == MAP_FAILED) {
         return nullptr;
       }
       return data;
     }
 
-    inline auto map_fd_write(Fd fd, size_t size) -> void* {
-      auto* data = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
-      if (data == MAP_FAILED) {
+    inline auto map_fd_read(Fd fd, size_t size, bool populate = false) -> void* {
+      return map_fd(fd, size, PROT_READ, populate);
+    }
+
+    inline auto map_fd_write(Fd fd, size_t size, bool populate = false) -> void* {
+      return map_fd(fd, size, PROT_READ | PROT_WRITE, populate);
+    }
+
+    // Grows or shrinks a shared mapping of `fd`, the file itself must already have the new size.
+    // On failure the old mapping is gone as well.
+    inline auto remap_fd(Fd fd, void* data, size_t size, size_t new_size, int prot) -> void* {
+#if defined(__linux__)
+      (void)fd;
+      (void)prot;
+      auto* moved = mremap(data, size, new_size, MREMAP_MAYMOVE);
+      if (moved == MAP_FAILED) {
+        munmap(data, size);
         return nullptr;
       }
-      return data;
+      return moved;
+#else
+      munmap(data, size);
+      return map_fd(fd, new_size, prot);
+#endif
+    }
+
+    inline auto unmap(void* data, size_t size) -> int {
+      return munmap(data, size);
+    }
+
+    inline auto advise_map(void* data, size_t size, int advice) -> int {
+      return madvise(data, size, advice);
+    }
+
+    // Asks for transparent huge pages, only honoured where the kernel supports them for the mapping.
+    inline auto advise_huge_pages(void* data, size_t size) -> int {
+#if defined(MADV_HUGEPAGE)
+      return madvise(data, size, MADV_HUGEPAGE);
+#else
+      (void)data;
+      (void)size;
+      return FAILED;
+#endif
+    }
+
+    inline auto sync_map(void* data, size_t size, bool wait) -> int {
+      return msync(data, size, wait ? MS_SYNC : MS_ASYNC);
+    }
+
+    inline auto close_fd(Fd fd) -> int {
+      return close(fd);
+    }
+
+    inline auto open_fd_nonblock(CStr path, int mode) -> Fd {
+      return open(path, mode | O_NONBLOCK | O_CLOEXEC);
+    }
+
+    inline auto lock_fd(Fd fd) -> int {
+      return flock(fd, LOCK_EX);
+    }
+
+    inline auto unlock_fd(Fd fd) -> int {
+      return flock(fd, LOCK_UN);
+    }
+
+    inline auto make_pipe(Fd (&fds)[2]) -> int {
+      return pipe(fds);
+    }
+
+    inline auto read_fd(Fd fd, void* data, size_t size) -> ssize_t {
+      ssize_t count;
+      do {
+        count = read(fd, data, size);
+      } while (count == FAILED && errno == EINTR);
+      return count;
+    }
+
+    inline auto write_fd(Fd fd, void const* data, size_t size) -> ssize_t {
+      ssize_t count;
+      do {
+        count = write(fd, data, size);
+      } while (count == FAILED && errno == EINTR);
+      return count;
+    }
+
+    // Only the read end is non-blocking, the child writes to a regular blocking pipe.
+    inline auto make_capture_pipe(Fd (&fds)[2]) -> int {
+#if defined(__linux__)
+      if (pipe2(fds, O_CLOEXEC) == FAILED) {
+        return FAILED;
+      }
+#else
+      if (pipe(fds) == FAILED) {
+        return FAILED;
+      }
+      fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+      fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+      return fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    }
+
+    inline auto wait_readable(Fd const* fds, size_t count, int timeout, bool* ready = nullptr) -> int {
+      pollfd polls[8];
+      count = count < 8 ? count : 8;
+      for (size_t i = 0; i < count; ++i) {
+        polls[i] = { .fd = fds[i], .events = POLLIN, .revents = 0 };
+      }
+
+      int res;
+      do {
+        res = poll(polls, count, timeout);
+      } while (res == FAILED && errno == EINTR);
+
+      for (size_t i = 0; ready && i < count; ++i) {
+        ready[i] = polls[i].revents != 0;
+      }
+      return res;
     }
 
   } // namespace io
 
+  namespace env {
+
+    inline auto get(CStr name) -> CStr {
+      return getenv(name);
+    }
+
+    inline auto set(CStr name, CStr value) -> int {
+      return setenv(name, value, 1);
+    }
+
+    inline auto unset(CStr name) -> int {
+      return unsetenv(name);
+    }
+
+  } // namespace env
+
+  namespace event {
+
+#if defined(__linux__)
+    using Event = epoll_event;
+#else
+    struct Event { unsigned long long key; };
+#endif
+
+    using Poller = io::Fd;
+
+    inline auto create() -> Poller {
+#if defined(__linux__)
+      return epoll_create1(EPOLL_CLOEXEC);
+#else
+      return io::FAILED;
+#endif
+    }
+
+    inline auto add(Poller poller, io::Fd fd, unsigned long long key) -> int {
+#if defined(__linux__)
+      auto event = Event { .events = EPOLLIN };
+      event.data.u64 = key;
+      return epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+#else
+      return io::FAILED;
+#endif
+    }
+
+    inline auto wait(Poller poller, Event* events, int cap, int timeout) -> int {
+#if defined(__linux__)
+      int count;
+      do {
+        count = epoll_wait(poller, events, cap, timeout);
+      } while (count == io::FAILED && errno == EINTR);
+      return count;
+#else
+      return io::FAILED;
+#endif
+    }
+
+    inline auto key(const Event& event) -> unsigned long long {
+#if defined(__linux__)
+      return event.data.u64;
+#else
+      return event.key;
+#endif
+    }
+
+  } // namespace event
+
   namespace process {
 
     using Pid = pid_t;
@@ -89,42 +323,125 @@ namespace sys::linux {
     
     constexpr static int FAILED = -1;
 
-    inline auto exec(io::Fd read, io::Fd write, CStr arg, char* const* args) -> Pid {
-      posix_spawn_file_actions_t file_actions;
+    // What a child cost, as reported by wait4 when it is reaped.
+    struct Usage {
+      long long user_us;
+      long long sys_us;
+      long max_rss_kb;
+      long voluntary_switches;
+      long involuntary_switches;
+    };
+
+    inline auto usage_from(const rusage& raw) -> Usage {
+      return {
+        raw.ru_utime.tv_sec * 1000000ll + raw.ru_utime.tv_usec,
+        raw.ru_stime.tv_sec * 1000000ll + raw.ru_stime.tv_usec,
+        raw.ru_maxrss,
+        raw.ru_nvcsw,
+        raw.ru_nivcsw,
+      };
+    }
+
+    // Spawn attributes and file actions are built once per thread and only rebuilt
+    // when the requested redirections change, which for most launches they never do.
+    struct SpawnState {
       posix_spawnattr_t attr;
+      posix_spawn_file_actions_t actions;
+      io::Fd read = io::STDIN;
+      io::Fd write = io::STDOUT;
+      io::Fd error = io::STDERR;
+      bool ready = false;
+
+      ~SpawnState() {
+        if (ready) {
+          posix_spawn_file_actions_destroy(&actions);
+          posix_spawnattr_destroy(&attr);
+        }
+      }
+    };
 
-      Pid pid;
-      Status status;
+    inline auto spawn_state(io::Fd read, io::Fd write, io::Fd error) -> SpawnState* {
+      thread_local SpawnState state;
 
-      if (posix_spawn_file_actions_init(&file_actions) != 0) {
-        return FAILED;
+      if (!state.ready) {
+        if (posix_spawnattr_init(&state.attr) != 0) {
+          return nullptr;
+        }
+#if defined(POSIX_SPAWN_USEVFORK)
+        posix_spawnattr_setflags(&state.attr, POSIX_SPAWN_USEVFORK);
+#endif
+        if (posix_spawn_file_actions_init(&state.actions) != 0) {
+          posix_spawnattr_destroy(&state.attr);
+          return nullptr;
+        }
+        state.ready = true;
+      }
+
+      if (state.read == read && state.write == write && state.error == error) {
+        return &state;
+      }
+
+      posix_spawn_file_actions_destroy(&state.actions);
+      if (posix_spawn_file_actions_init(&state.actions) != 0) {
+        posix_spawnattr_destroy(&state.attr);
+        state.ready = false;
+        return nullptr;
       }
 
       if (read != io::STDIN) {
-        posix_spawn_file_actions_adddup2(&file_actions, read, io::STDIN);
+        posix_spawn_file_actions_adddup2(&state.actions, read, io::STDIN);
       }
 
-      if (write != io::STDIN) {
-        posix_spawn_file_actions_adddup2(&file_actions, write, io::STDIN);
+      if (write != io::STDOUT) {
+        posix_spawn_file_actions_adddup2(&state.actions, write, io::STDOUT);
       }
 
-      posix_spawnattr_init(&attr);
+      if (error != io::STDERR) {
+        posix_spawn_file_actions_adddup2(&state.actions, error, io::STDERR);
+      }
 
-      status = posix_spawnp(&pid, arg, &file_actions, &attr, args, environ);
+      state.read = read;
+      state.write = write;
+      state.error = error;
+      return &state;
+    }
 
-      posix_spawn_file_actions_destroy(&file_actions);
-      posix_spawnattr_destroy(&attr);
+    // `arg` may already be a resolved path, posix_spawnp skips the PATH search for those.
+    inline auto exec(io::Fd read, io::Fd write, CStr arg, char* const* args, io::Fd error = io::STDERR) -> Pid {
+      auto* state = spawn_state(read, write, error);
+      if (!state) {
+        return FAILED;
+      }
 
-      if (status != 0) {
+      Pid pid;
+      if (posix_spawnp(&pid, arg, &state->actions, &state->attr, args, environ) != 0) {
         return FAILED;
       }
 
       return pid;
     }
 
-    inline auto wait(Pid pid) -> Status {
+    inline auto executable(CStr path) -> bool {
+      struct stat st;
+      return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+    }
+
+    // Replaces the running program with `path`, keeping the pid and stdio. Only returns on failure.
+    inline auto replace(CStr path, char* const* args) -> Status {
+      execv(path, args);
+      return FAILED;
+    }
+
+    inline auto wait(Pid pid, Usage* usage = nullptr) -> Status {
       auto status = Status{};
-      waitpid(pid, &status, 0);
+      auto raw = rusage{};
+      if (wait4(pid, &status, 0, &raw) == FAILED) {
+        return FAILED;
+      }
+
+      if (usage) {
+        *usage = usage_from(raw);
+      }
 
       if (WIFEXITED(status)) {
         return WEXITSTATUS(status);
@@ -133,9 +450,102 @@ namespace sys::linux {
       return FAILED;
     }
 
+    inline auto kill(Pid pid) -> int {
+      return ::kill(pid, SIGKILL);
+    }
+
+    inline auto try_wait(Pid pid, Status& status, Usage* usage = nullptr) -> bool {
+      auto raw = Status{};
+      auto raw_usage = rusage{};
+      const auto res = wait4(pid, &raw, WNOHANG, &raw_usage);
+      if (res == 0) {
+        return false;
+      }
+
+      if (usage && res != FAILED) {
+        *usage = usage_from(raw_usage);
+      }
+
+      status = (res != FAILED && WIFEXITED(raw)) ? WEXITSTATUS(raw) : FAILED;
+      return true;
+    }
+
+    // Like try_wait, but leaves the child to be reaped by whoever owns it. A child that
+    // was already reaped reports FAILED, its status is gone.
+    inline auto peek(Pid pid, Status& status) -> bool {
+      auto info = siginfo_t{};
+      if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == FAILED) {
+        status = FAILED;
+        return true;
+      }
+      if (info.si_pid == 0) {
+        return false;
+      }
+
+      status = info.si_code == CLD_EXITED ? info.si_status : FAILED;
+      return true;
+    }
+
     inline auto completed(Pid pid) -> bool {
-      auto status = Status{};
-      return waitpid(pid, &status, WNOHANG) != 0;
+      auto info = siginfo_t{};
+      if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == FAILED) {
+        return true;
+      }
+      return info.si_pid != 0;
+    }
+
+    inline auto cpu_count() -> size_t {
+      const auto count = sysconf(_SC_NPROCESSORS_ONLN);
+      return count > 0 ? static_cast<size_t>(count) : 1;
+    }
+
+    // Bytes this process may use: the tightest cgroup v2 memory.max on the way up from its
+    // cgroup, or all of physical memory when nothing is set.
+    inline auto memory_limit() -> unsigned long long {
+      auto limit = static_cast<unsigned long long>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+#if defined(__linux__)
+      const auto read_text = [](CStr path, char* text, size_t size) -> bool {
+        const auto fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == FAILED) {
+          return false;
+        }
+        const auto count = read(fd, text, size - 1);
+        close(fd);
+        text[count > 0 ? count : 0] = '\0';
+        return count > 0;
+      };
+
+      char text[4096];
+      if (!read_text("/proc/self/cgroup", text, sizeof(text)) || std::strncmp(text, "0::", 3) != 0) {
+        return limit;
+      }
+
+      char path[4096 + 32] = "/sys/fs/cgroup";
+      std::strncat(path, text + 3, std::strcspn(text + 3, "\n"));
+      for (auto len = std::strlen(path); len >= std::strlen("/sys/fs/cgroup"); ) {
+        std::strcpy(path + len, "/memory.max");
+        char value[32];
+        if (read_text(path, value, sizeof(value)) && value[0] >= '0' && value[0] <= '9') {
+          limit = std::min(limit, std::strtoull(value, nullptr, 10));
+        }
+
+        path[len] = '\0';
+        const auto* parent = std::strrchr(path, '/');
+        if (!parent || parent == path) {
+          break;
+        }
+        len = parent - path;
+      }
+#endif
+      return limit;
+    }
+
+    inline auto open_handle(Pid pid) -> io::Fd {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+      return static_cast<io::Fd>(syscall(SYS_pidfd_open, pid, 0));
+#else
+      return io::FAILED;
+#endif
     }
 
   } // namespace process
@@ -209,9 +619,50 @@ namespace bstb {
     }
   };
 
+  struct OwnedFd {
+    sys::io::Fd fd = sys::io::FAILED;
+
+    OwnedFd() = default;
+
+    explicit OwnedFd(sys::io::Fd _fd) : fd(_fd) {}
+
+    OwnedFd(OwnedFd&& other) noexcept : fd(std::exchange(other.fd, sys::io::FAILED)) {}
+
+    auto operator=(OwnedFd&& other) noexcept -> OwnedFd& {
+      if (this != &other) {
+        this->reset(std::exchange(other.fd, sys::io::FAILED));
+      }
+      return *this;
+    }
+
+    inline auto get() const -> sys::io::Fd {
+      return fd;
+    }
+
+    inline auto valid() const -> bool {
+      return fd != sys::io::FAILED;
+    }
+
+    inline auto release() -> sys::io::Fd {
+      return std::exchange(fd, sys::io::FAILED);
+    }
+
+    inline auto reset(sys::io::Fd _fd = sys::io::FAILED) -> void {
+      if (this->valid()) {
+        sys::io::close_fd(fd);
+      }
+      fd = _fd;
+    }
+
+    ~OwnedFd() {
+      this->reset();
+    }
+  };
+
   struct Pipe {
     sys::io::Fd read;
     sys::io::Fd write;
+    bool capture {};
 
     static inline auto Inherited() -> Pipe {
       return { sys::io::STDIN, sys::io::STDOUT };
@@ -226,6 +677,11 @@ namespace bstb {
       static auto write = sys::io::open_fd_write(sys::io::NULL_PATH);
       return { read, write };
     }
+
+    // Every command gets its own stdout and stderr pipes, handed back through its Future.
+    static inline auto Capture() -> Pipe {
+      return { Null().read, sys::io::FAILED, true };
+    }
   };
 
   struct Dylib {
@@ -280,98 +736,507 @@ namespace bstb {
     }
   };
 
+  // Owns a shared mapping of a file and the fd behind it, unmapped and closed on destruction.
   struct MMap {
-    sys::io::Fd fd;
-    size_t size;
-    void* data;
+    enum Advice {
+      Normal = sys::io::MapNormal,
+      Sequential = sys::io::MapSequential,
+      Random = sys::io::MapRandom,
+      WillNeed = sys::io::MapWillNeed,
+    };
+
+    struct Options {
+      Advice advice = Normal;
+      bool populate = false;
+      bool huge_pages = false;
+    };
+
+    OwnedFd fd {};
+    size_t size {};
+    void* data {};
+    bool writable {};
+
+    MMap() = default;
+
+    MMap(OwnedFd _fd, size_t _size, void* _data, bool _writable)
+      : fd(std::move(_fd)), size(_size), data(_data), writable(_writable) {}
+
+    MMap(MMap&& other) noexcept
+      : fd(std::move(other.fd)),
+        size(std::exchange(other.size, 0)),
+        data(std::exchange(other.data, nullptr)),
+        writable(std::exchange(other.writable, false)) {}
+
+    auto operator=(MMap&& other) noexcept -> MMap& {
+      if (this != &other) {
+        this->unmap();
+        fd = std::move(other.fd);
+        size = std::exchange(other.size, 0);
+        data = std::exchange(other.data, nullptr);
+        writable = std::exchange(other.writable, false);
+      }
+      return *this;
+    }
+
+    ~MMap() {
+      this->unmap();
+    }
 
     inline static auto Read(CStr path) -> Result<MMap> {
-      auto fd = sys::io::open_fd_read(path);
-      if (fd == sys::io::FAILED) {
+      return Read(path, Options{});
+    }
+
+    // Empty files are valid and map to no data.
+    inline static auto Read(CStr path, Options options) -> Result<MMap> {
+      auto fd = OwnedFd(sys::io::open_fd_read(path));
+      if (!fd.valid()) {
         return { .err = { "Failed to open fd." } };
       }
 
-      auto size = sys::io::get_fd_size(fd);
-      auto* data = sys::io::map_fd_read(fd, size);
-      if (!data) {
-        return { .err = { "Failed to map file." } };
+      const auto size = sys::io::get_fd_size(fd.get());
+      auto map = MMap(std::move(fd), size, nullptr, false);
+      if (auto err = map.map(options)) {
+        return { .err = err };
       }
 
-      return {{ fd, size, data }};
+      return { std::move(map) };
     }
 
     inline static auto Write(CStr path, size_t size) -> Result<MMap> {
-      auto fd = sys::io::open_fd_write(path);
-      if (fd == sys::io::FAILED) {
+      return Write(path, size, Options{});
+    }
+
+    // Sizes the file before mapping it, pages past the end of a file can't be touched.
+    inline static auto Write(CStr path, size_t size, Options options) -> Result<MMap> {
+      auto fd = OwnedFd(sys::io::open_fd_write(path));
+      if (!fd.valid()) {
         return { .err = { "Failed to open fd." } };
       }
-      
-      auto* data = sys::io::map_fd_write(fd, size);
-      sys::io::fd_truncate(fd, size);
-      if (!data) {
-        return { .err = { "Failed to map file." } };
+
+      if (sys::io::fd_truncate(fd.get(), size) == sys::io::FAILED) {
+        return { .err = { "Failed to size file." } };
       }
 
-      return {{ fd, size, data }};
+      auto map = MMap(std::move(fd), size, nullptr, true);
+      if (auto err = map.map(options)) {
+        return { .err = err };
+      }
+
+      return { std::move(map) };
     }
-  };
 
-} // namespace bstb
+    inline auto map(const Options& options) -> Err {
+      if (size == 0) {
+        return {};
+      }
 
-#endif // BSTB_IMPL || BSTB_RT
+      data = writable
+        ? sys::io::map_fd_write(fd.get(), size, options.populate)
+        : sys::io::map_fd_read(fd.get(), size, options.populate);
+      if (!data) {
+        return { "Failed to map file." };
+      }
 
-#ifdef BSTB_IMPL
+      if (options.advice != Normal) {
+        this->advise(options.advice);
+      }
+      if (options.huge_pages) {
+        sys::io::advise_huge_pages(data, size);
+      }
 
-#include <string_view>
-#include <filesystem>
-#include <iostream>
-#include <iterator>
-#include <fstream>
-#include <cstring>
-#include <thread>
-#include <vector>
-#include <cmath>
-#include <span>
+      return {};
+    }
 
-namespace bstb::buffer {
+    inline auto bytes() const -> std::span<unsigned char> {
+      return { static_cast<unsigned char*>(data), size };
+    }
 
-  template <typename T>
-  concept Buffer = requires(T buf, const T buf_const, T& buf_ref, std::string_view sv, std::ostream& os) {
-    { std::is_trivially_constructible_v<T> };
-    { std::is_trivially_destructible_v<T> };
-    { std::is_trivially_copyable_v<T> };
+    inline auto advise(Advice advice) -> int {
+      return data ? sys::io::advise_map(data, size, advice) : 0;
+    }
 
-    { buf.exec_args() } -> std::same_as<char* const*>;
-    { buf.size() } -> std::same_as<size_t>;
-    { buf.push(sv, sv) } -> std::same_as<void>;
-    { buf[std::size_t{}] } -> std::same_as<CStr>;
-    { buf_const[std::size_t{}] } -> std::same_as<CStr>;
-    { os << buf_ref } -> std::same_as<std::ostream&>;
-  };
+    // Flushes dirty pages back to the file, `wait` blocks until they are written.
+    inline auto sync(bool wait = true) -> int {
+      return data && writable ? sys::io::sync_map(data, size, wait) : 0;
+    }
 
-  struct HeapBuffer {
-    std::vector<std::string> buffer;
-    std::vector<CStr> exec_buffer;
+    // Resizes the file and then the mapping. `data` may move, pointers into it are invalidated.
+    inline auto resize(size_t new_size) -> Err {
+      if (!writable) {
+        return { "Can't resize a read only map." };
+      }
 
-    [[nodiscard]]
-    auto exec_args() -> char* const* {
-      exec_buffer.clear();
-      exec_buffer.reserve(buffer.size() + 1);
+      if (new_size < size && data) {
+        this->sync();
+      }
 
-      for (const auto& str : buffer) {
-        exec_buffer.push_back(&str[0]);
+      if (sys::io::fd_truncate(fd.get(), new_size) == sys::io::FAILED) {
+        return { "Failed to size file." };
       }
-      exec_buffer.push_back(nullptr);
 
-      return const_cast<char* const*>(exec_buffer.data());
-    }
+      if (!data || new_size == 0) {
+        this->unmap();
+        size = new_size;
+        return this->map(Options{});
+      }
 
-    [[nodiscard]]
-    constexpr auto size() -> size_t {
-      return buffer.size();
+      auto* moved = sys::io::remap_fd(fd.get(), data, size, new_size, PROT_READ | PROT_WRITE);
+      if (!moved) {
+        data = nullptr;
+        size = 0;
+        return { "Failed to remap file." };
+      }
+
+      data = moved;
+      size = new_size;
+      return {};
     }
 
-    template <typename... Args>
+    inline auto unmap() -> void {
+      if (data) {
+        sys::io::unmap(data, size);
+        data = nullptr;
+      }
+    }
+  };
+
+} // namespace bstb
+
+namespace bstb::hash {
+
+  // 64-bit FNV-1a, good enough for cache keys and not worth a dependency.
+  struct Fnv {
+    uint64_t state = 0xcbf29ce484222325ull;
+
+    constexpr auto update(unsigned char const* data, size_t size) -> Fnv& {
+      for (size_t i = 0; i < size; ++i) {
+        state = (state ^ data[i]) * 0x100000001b3ull;
+      }
+      return *this;
+    }
+
+    constexpr auto update(std::string_view str) -> Fnv& {
+      for (const auto ch : str) {
+        state = (state ^ static_cast<unsigned char>(ch)) * 0x100000001b3ull;
+      }
+      return *this;
+    }
+
+    constexpr auto digest() const -> uint64_t {
+      return state;
+    }
+  };
+
+  // splitmix64 finalizer, spreads FNV's weak low bits before they are used as an index.
+  constexpr auto mix(uint64_t value) -> uint64_t {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+  }
+
+} // namespace bstb::hash
+
+namespace bstb::lz {
+
+  // A small LZ77 block format shared by the embedder (which compresses) and the runtime
+  // (which decompresses). Each sequence is a token byte holding the literal count in its
+  // high nibble and the match length minus MinMatch in its low nibble, either nibble
+  // saturating at 15 and continuing in 255-terminated extension bytes. The literals follow,
+  // then a little endian 16 bit offset. The final sequence has literals only.
+  constexpr inline size_t MinMatch = 4;
+  constexpr inline size_t MaxOffset = 0xFFFF;
+
+  inline auto decompress(unsigned char const* src, size_t src_size, unsigned char* dst, size_t dst_size) -> bool {
+    const auto* src_end = src + src_size;
+    auto* const dst_begin = dst;
+    auto* const dst_end = dst + dst_size;
+
+    const auto read_length = [&](size_t length) -> size_t {
+      if (length != 15) {
+        return length;
+      }
+      for (unsigned char byte = 255; byte == 255 && src < src_end; ) {
+        byte = *src++;
+        length += byte;
+      }
+      return length;
+    };
+
+    while (src < src_end) {
+      const auto token = *src++;
+
+      const auto literals = read_length(token >> 4);
+      if (literals > static_cast<size_t>(src_end - src) || literals > static_cast<size_t>(dst_end - dst)) {
+        return false;
+      }
+      for (size_t i = 0; i < literals; ++i) {
+        *dst++ = *src++;
+      }
+
+      if (src == src_end) {
+        break;
+      }
+
+      if (src_end - src < 2) {
+        return false;
+      }
+      const auto offset = static_cast<size_t>(src[0]) | (static_cast<size_t>(src[1]) << 8);
+      src += 2;
+
+      const auto length = read_length(token & 0xF) + MinMatch;
+      if (offset == 0 || offset > static_cast<size_t>(dst - dst_begin) || length > static_cast<size_t>(dst_end - dst)) {
+        return false;
+      }
+
+      // Matches may overlap their own output, so this has to go byte by byte.
+      const auto* match = dst - offset;
+      for (size_t i = 0; i < length; ++i) {
+        *dst++ = *match++;
+      }
+    }
+
+    return dst == dst_end;
+  }
+
+  // Decompresses into a buffer that lives for the rest of the program. Used by the
+  // accessors of compressed embeds on first use. Buffers are keyed on the payload's
+  // address, so a payload is only ever inflated once however many accessors reach it.
+  inline auto inflate_once(unsigned char const* src, size_t src_size, size_t size) -> unsigned char const* {
+    struct Inflated {
+      unsigned char const* src;
+      unsigned char const* data;
+      Inflated* next;
+    };
+
+    static auto head = std::atomic<Inflated*>{};
+    for (auto* it = head.load(std::memory_order_acquire); it; it = it->next) {
+      if (it->src == src) {
+        return it->data;
+      }
+    }
+
+    auto* data = new unsigned char[size + 1];
+    data[size] = 0;
+    if (!decompress(src, src_size, data, size)) {
+      delete[] data;
+      return nullptr;
+    }
+
+    auto* inflated = new Inflated{ src, data, head.load(std::memory_order_relaxed) };
+    while (!head.compare_exchange_weak(inflated->next, inflated, std::memory_order_release, std::memory_order_relaxed)) {}
+    return data;
+  }
+
+} // namespace bstb::lz
+
+namespace bstb {
+
+  // Many files packed into one blob behind a minimal perfect hash of their names, written
+  // by embedder::pack. The blob is laid out as a header, one displacement seed per
+  // bucket, a table of entries and then the names and the file contents, every file
+  // aligned to PackAlign.
+  struct Pack {
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t count;
+      uint64_t seeds;
+      uint64_t entries;
+    };
+
+    struct Entry {
+      uint64_t name;
+      uint64_t name_size;
+      uint64_t data;
+      uint64_t data_size;
+    };
+
+    constexpr static char Magic[8] = { 'B', 'S', 'T', 'B', 'P', 'A', 'C', 'K' };
+    constexpr static uint32_t Version = 1;
+    constexpr static size_t Align = 64;
+
+    MMap map {};
+    unsigned char const* base {};
+    size_t size {};
+    Header header {};
+
+    // Hashes a name once, the bucket and the final slot are both derived from it.
+    constexpr static auto hash(std::string_view name) -> uint64_t {
+      return hash::Fnv{}.update(name).digest();
+    }
+
+    constexpr static auto bucket(uint64_t hashed, uint32_t count) -> uint32_t {
+      return static_cast<uint32_t>(hash::mix(hashed) % count);
+    }
+
+    constexpr static auto slot(uint64_t hashed, uint32_t seed, uint32_t count) -> uint32_t {
+      return static_cast<uint32_t>(hash::mix(hashed + (seed + 1) * 0x9E3779B97F4A7C15ull) % count);
+    }
+
+    // Wraps a pack that is already in memory, e.g. one embedded with embedder::incbin_cpp.
+    static inline auto View(void const* data, size_t size) -> Result<Pack> {
+      auto pack = Pack{};
+      pack.base = static_cast<unsigned char const*>(data);
+      pack.size = size;
+
+      if (size < sizeof(Header)) {
+        return { .err = { "Pack is too small." } };
+      }
+
+      std::memcpy(&pack.header, data, sizeof(Header));
+      const auto& header = pack.header;
+      if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        return { .err = { "Not a bootstrab pack." } };
+      }
+
+      const auto count = uint64_t{ header.count };
+      if (header.seeds > size || count * sizeof(uint32_t) > size - header.seeds ||
+          header.entries > size || count * sizeof(Entry) > size - header.entries) {
+        return { .err = { "Pack index is out of bounds." } };
+      }
+
+      for (uint32_t i = 0; i < header.count; ++i) {
+        const auto entry = pack.entry(i);
+        if (entry.name > size || entry.name_size > size - entry.name ||
+            entry.data > size || entry.data_size > size - entry.data) {
+          return { .err = { "Pack entry is out of bounds." } };
+        }
+      }
+
+      return { std::move(pack) };
+    }
+
+    static inline auto Open(CStr path) -> Result<Pack> {
+      auto [map, err] = MMap::Read(path);
+      if (err) {
+        return { .err = err };
+      }
+
+      auto [pack, view_err] = View(map.data, map.size);
+      if (view_err) {
+        return { .err = view_err };
+      }
+
+      pack.map = std::move(map);
+      return { std::move(pack) };
+    }
+
+    inline auto count() const -> size_t {
+      return header.count;
+    }
+
+    // The index is read with memcpy so packs embedded as plain byte arrays need no alignment.
+    inline auto seed(size_t bucket) const -> uint32_t {
+      auto seed = uint32_t{};
+      std::memcpy(&seed, base + header.seeds + bucket * sizeof(uint32_t), sizeof(seed));
+      return seed;
+    }
+
+    inline auto entry(size_t idx) const -> Entry {
+      auto entry = Entry{};
+      std::memcpy(&entry, base + header.entries + idx * sizeof(Entry), sizeof(entry));
+      return entry;
+    }
+
+    inline auto name(size_t idx) const -> std::string_view {
+      const auto entry = this->entry(idx);
+      return { reinterpret_cast<char const*>(base + entry.name), entry.name_size };
+    }
+
+    inline auto data(size_t idx) const -> std::span<const unsigned char> {
+      const auto entry = this->entry(idx);
+      return { base + entry.data, entry.data_size };
+    }
+
+    // One hash, one seed lookup and one name compare. Unknown names return an empty span.
+    inline auto find(std::string_view name) const -> std::span<const unsigned char> {
+      if (header.count == 0) {
+        return {};
+      }
+
+      const auto hashed = hash(name);
+      const auto idx = slot(hashed, this->seed(bucket(hashed, header.count)), header.count);
+      if (this->name(idx) != name) {
+        return {};
+      }
+      return this->data(idx);
+    }
+  };
+
+} // namespace bstb
+
+#endif // BSTB_IMPL || BSTB_RT
+
+#ifdef BSTB_IMPL
+
+#include <string_view>
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace bstb::buffer {
+
+  template <typename T>
+  concept Buffer = requires(T buf, const T buf_const, T& buf_ref, std::string_view sv, std::ostream& os) {
+    { std::is_trivially_constructible_v<T> };
+    { std::is_trivially_destructible_v<T> };
+    { std::is_trivially_copyable_v<T> };
+
+    { buf.exec_args() } -> std::same_as<char* const*>;
+    { buf.size() } -> std::same_as<size_t>;
+    { buf.push(sv, sv) } -> std::same_as<void>;
+    { buf[std::size_t{}] } -> std::same_as<CStr>;
+    { buf_const[std::size_t{}] } -> std::same_as<CStr>;
+    { os << buf_ref } -> std::same_as<std::ostream&>;
+  };
+
+  struct HeapBuffer {
+    std::vector<std::string> buffer;
+    std::vector<CStr> exec_buffer;
+
+    [[nodiscard]]
+    auto exec_args() -> char* const* {
+      exec_buffer.clear();
+      exec_buffer.reserve(buffer.size() + 1);
+
+      for (const auto& str : buffer) {
+        exec_buffer.push_back(&str[0]);
+      }
+      exec_buffer.push_back(nullptr);
+
+      return const_cast<char* const*>(exec_buffer.data());
+    }
+
+    [[nodiscard]]
+    constexpr auto size() -> size_t {
+      return buffer.size();
+    }
+
+    template <typename... Args>
     auto push(Args&&... args) -> void {
       if constexpr (sizeof...(Args) == 1) {
         buffer.emplace_back(std::forward<Args>(args)...);
@@ -404,8 +1269,14 @@ namespace bstb::buffer {
     std::array<char, Cap> buffer;
     std::array<CStr, Cap/8> exec_buffer;
 
+    // Pointers are rebuilt on every call so that copies of the buffer never point
+    // into the storage of the buffer they were copied from.
     [[nodiscard]]
     constexpr auto exec_args() -> char* const* {
+      for (size_t i = 0, offset = 0; i < exec_buffer_idx; ++i) {
+        exec_buffer[i] = &buffer[offset];
+        while (buffer[offset++] != '\0');
+      }
       exec_buffer[exec_buffer_idx] = nullptr;
       return const_cast<char* const*>(exec_buffer.data());
     }
@@ -417,7 +1288,7 @@ namespace bstb::buffer {
 
     template <typename... Args>
     constexpr auto push(Args&&... args) -> void {
-      exec_buffer[exec_buffer_idx++] = &buffer[buffer_idx];
+      ++exec_buffer_idx;
 
       auto push_every = [this] (std::string_view str) {
         std::copy(str.begin(), str.end(), &buffer[buffer_idx]);
@@ -445,6 +1316,158 @@ namespace bstb::buffer {
     }
   };
 
+  // Monotonic memory shared by a batch of ArenaBuffers, everything is freed at once by release().
+  struct Arena {
+    std::pmr::monotonic_buffer_resource resource { 1 << 16 };
+
+    inline auto allocate(size_t size, size_t align) -> void* {
+      return resource.allocate(size, align);
+    }
+
+    inline auto release() -> void {
+      resource.release();
+    }
+
+    static inline auto Default() -> Arena& {
+      thread_local auto arena = Arena{};
+      return arena;
+    }
+  };
+
+  // Arguments and the argv table live in an Arena, so pushing never calls malloc and
+  // exec_args() hands out the table as is. Copies share the table until one of them
+  // grows past the other, which then moves to a table of its own.
+  struct ArenaBuffer {
+    struct Table {
+      size_t used;
+      size_t cap;
+
+      inline auto args() -> CStr* {
+        return reinterpret_cast<CStr*>(this + 1);
+      }
+    };
+
+    Arena* arena = &Arena::Default();
+    Table* table = nullptr;
+    size_t count = 0;
+
+    auto reserve(size_t cap) -> void {
+      auto* grown = static_cast<Table*>(arena->allocate(sizeof(Table) + sizeof(CStr) * cap, alignof(Table)));
+      grown->used = count;
+      grown->cap = cap;
+      if (table) {
+        std::copy_n(table->args(), count, grown->args());
+      }
+      table = grown;
+    }
+
+    [[nodiscard]]
+    auto exec_args() -> char* const* {
+      if (!table || table->used != count) {
+        this->reserve(count + 1);
+      }
+      table->args()[count] = nullptr;
+      return const_cast<char* const*>(table->args());
+    }
+
+    [[nodiscard]]
+    constexpr auto size() const -> size_t {
+      return count;
+    }
+
+    template <typename... Args>
+    auto push(Args&&... args) -> void {
+      const auto len = (std::string_view{ args }.size() + ... + 1);
+      auto* str = static_cast<char*>(arena->allocate(len, 1));
+
+      auto* idx = str;
+      auto push_every = [&idx] (std::string_view arg) {
+        idx = std::copy(arg.begin(), arg.end(), idx);
+      };
+      (push_every(std::forward<Args>(args)), ...);
+      *idx = '\0';
+
+      if (!table || table->used != count || count + 2 > table->cap) {
+        this->reserve(std::max<size_t>(8, count * 2 + 2));
+      }
+
+      table->args()[count++] = str;
+      table->args()[count] = nullptr;
+      table->used = count;
+    }
+
+    auto operator[](size_t idx) -> CStr {
+      return table->args()[idx];
+    }
+
+    auto operator[](size_t idx) const -> CStr {
+      return table->args()[idx];
+    }
+
+    friend auto operator<<(std::ostream& os, ArenaBuffer& buffer) -> std::ostream& {
+      for (size_t i = 0; i < buffer.count; ++i) {
+        os << buffer[i] << ' ';
+      }
+      return os;
+    }
+  };
+
+  template <size_t N>
+  struct Literal {
+    char str[N] {};
+
+    constexpr Literal() = default;
+
+    consteval Literal(const char (&_str)[N]) {
+      std::copy_n(_str, N, str);
+    }
+
+    constexpr auto view() const -> std::string_view {
+      return { str, N - 1 };
+    }
+  };
+
+  template <size_t N, size_t M>
+  consteval auto operator+(const Literal<N>& lhs, const Literal<M>& rhs) -> Literal<N + M - 1> {
+    auto joined = Literal<N + M - 1>{};
+    std::copy_n(lhs.str, N - 1, joined.str);
+    std::copy_n(rhs.str, M, joined.str + N - 1);
+    return joined;
+  }
+
+  // Arguments known at compile time. The argv table is a constant pointing at the template
+  // parameter objects, so it lives in read only data and building the buffer costs nothing.
+  template <Literal... Args>
+  struct StaticBuffer {
+    constexpr static CStr args[] = { Args.str..., nullptr };
+
+    [[nodiscard]]
+    constexpr auto exec_args() const -> char* const* {
+      return const_cast<char* const*>(args);
+    }
+
+    [[nodiscard]]
+    constexpr auto size() const -> size_t {
+      return sizeof...(Args);
+    }
+
+    template <typename... Push>
+    auto push(Push&&...) -> void {
+      static_assert(sizeof...(Push) == 0, "StaticBuffer arguments are fixed at compile time.");
+    }
+
+    constexpr auto operator[](size_t idx) const -> CStr {
+      return args[idx];
+    }
+
+    friend auto operator<<(std::ostream& os, StaticBuffer&) -> std::ostream& {
+      for (size_t i = 0; i < sizeof...(Args); ++i) {
+        os << args[i] << ' ';
+      }
+      return os;
+    }
+  };
+
   #ifndef BSTB_DEFAULT_BUFFER
   #define BSTB_DEFAULT_BUFFER HeapBuffer
   #endif
@@ -476,31 +1499,197 @@ namespace bstb::fs {
     return _path;
   }
 
-  inline auto modified_after(const path& path1, const path& path2) -> bool {
-    if (!fs::exists(path1)) {
-      return false;
-    }
-    if (!fs::exists(path2)) {
-      return true;
+  // Stat results gathered once and served from memory, so a dependency scan touches
+  // every header a single time no matter how many objects include it.
+  struct Snapshot {
+    std::unordered_map<std::string, sys::io::FileInfo> files {};
+    std::vector<std::string> queued {};
+    size_t threads = sys::process::cpu_count();
+
+    auto add(const path& _path) -> void {
+      auto key = _path.native();
+      if (!files.contains(key)) {
+        queued.push_back(std::move(key));
+      }
     }
-    return last_write_time(path1) > last_write_time(path2);
-  }
 
-  namespace {
-    template <typename T, typename Pred>
-    struct Iter {
-      using iterator_category = typename std::input_iterator_tag;
-      using value_type = typename T::value_type;
-      using difference_type = typename T::difference_type;
-      using pointer = typename T::pointer;
-      using reference = typename T::reference;
-      
-      T curr;
-      T last {};
-      Pred pred;
+    // Stats every queued path, split across threads once there are enough of them.
+    auto fill() -> void {
+      constexpr static size_t PerThread = 256;
 
-      explicit Iter(const T& _curr, Pred&& _pred) :
-        curr(_curr),
+      auto slots = std::vector<std::pair<CStr, sys::io::FileInfo*>>{};
+      slots.reserve(queued.size());
+      for (auto& key : queued) {
+        auto [it, inserted] = files.try_emplace(std::move(key));
+        if (inserted) {
+          slots.emplace_back(it->first.c_str(), &it->second);
+        }
+      }
+      queued.clear();
+
+      const auto workers = std::clamp<size_t>(slots.size() / PerThread, 1, std::max<size_t>(threads, 1));
+      const auto stat_range = [&slots, workers](size_t worker) {
+        for (auto idx = worker; idx < slots.size(); idx += workers) {
+          *slots[idx].second = sys::io::stat_path(slots[idx].first);
+        }
+      };
+
+      auto pool = std::vector<std::thread>{};
+      for (size_t worker = 1; worker < workers; ++worker) {
+        pool.emplace_back(stat_range, worker);
+      }
+      stat_range(0);
+      for (auto& thread : pool) {
+        thread.join();
+      }
+    }
+
+    auto info(const path& _path) -> const sys::io::FileInfo& {
+      auto [it, inserted] = files.try_emplace(_path.native());
+      if (inserted) {
+        it->second = sys::io::stat_path(it->first.c_str());
+      }
+      return it->second;
+    }
+
+    auto exists(const path& _path) -> bool {
+      return this->info(_path).exists;
+    }
+
+    auto mtime(const path& _path) -> long long {
+      return this->info(_path).mtime;
+    }
+
+    auto size(const path& _path) -> unsigned long long {
+      return this->info(_path).size;
+    }
+
+    auto invalidate(const path& _path) -> void {
+      files.erase(_path.native());
+    }
+
+    auto invalidate() -> void {
+      files.clear();
+    }
+  };
+
+  inline auto modified_after(const path& path1, const path& path2, Snapshot* snapshot = nullptr) -> bool {
+    if (snapshot) {
+      const auto& info1 = snapshot->info(path1);
+      const auto& info2 = snapshot->info(path2);
+      return info1.exists && (!info2.exists || info1.mtime > info2.mtime);
+    }
+
+    if (!fs::exists(path1)) {
+      return false;
+    }
+    if (!fs::exists(path2)) {
+      return true;
+    }
+    return last_write_time(path1) > last_write_time(path2);
+  }
+
+  // Parses a make style depfile as written by `-MMD -MF`, returning every prerequisite.
+  inline auto read_depfile(const path& depfile) -> Result<std::vector<path>> {
+    auto file = std::ifstream(depfile, std::ios::in | std::ios::binary);
+    if (!file) {
+      return { .err = { "Failed to open depfile." } };
+    }
+
+    const auto text = std::string(std::istreambuf_iterator<char>(file), {});
+
+    auto deps = std::vector<path>{};
+    auto token = std::string{};
+
+    const auto flush = [&] {
+      if (!token.empty() && token.back() != ':') {
+        deps.emplace_back(token);
+      }
+      token.clear();
+    };
+
+    for (size_t i = 0; i < text.size(); ++i) {
+      const auto ch = text[i];
+      if (ch == '\\' && i + 1 < text.size()) {
+        const auto next = text[i + 1];
+        if (next == '\n' || next == '\r') {
+          flush();
+        } else if (next == ' ' || next == '#' || next == '\\') {
+          token += next;
+        } else {
+          token += ch;
+          continue;
+        }
+        ++i;
+      } else if (ch == '$' && i + 1 < text.size() && text[i + 1] == '$') {
+        token += '$';
+        ++i;
+      } else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+        flush();
+      } else {
+        token += ch;
+      }
+    }
+    flush();
+
+    return { std::move(deps) };
+  }
+
+  // An output is up to date when it is newer than every prerequisite listed in its depfile.
+  inline auto up_to_date(const path& output, const path& depfile, Snapshot* snapshot = nullptr) -> bool {
+    if (snapshot && !snapshot->exists(output)) {
+      return false;
+    }
+
+    auto ec = std::error_code{};
+    const auto output_time = snapshot ? file_time_type{} : last_write_time(output, ec);
+    if (ec) {
+      return false;
+    }
+
+    const auto [deps, err] = read_depfile(depfile);
+    if (err || deps.empty()) {
+      return false;
+    }
+
+    if (snapshot) {
+      for (const auto& dep : deps) {
+        snapshot->add(dep);
+      }
+      snapshot->fill();
+
+      const auto output_mtime = snapshot->mtime(output);
+      return std::all_of(deps.begin(), deps.end(), [&](const auto& dep) {
+        const auto& info = snapshot->info(dep);
+        return info.exists && info.mtime <= output_mtime;
+      });
+    }
+
+    for (const auto& dep : deps) {
+      const auto dep_time = last_write_time(dep, ec);
+      if (ec || dep_time > output_time) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  namespace {
+    template <typename T, typename Pred>
+    struct Iter {
+      using iterator_category = typename std::input_iterator_tag;
+      using value_type = typename T::value_type;
+      using difference_type = typename T::difference_type;
+      using pointer = typename T::pointer;
+      using reference = typename T::reference;
+      
+      T curr;
+      T last {};
+      Pred pred;
+
+      explicit Iter(const T& _curr, Pred&& _pred) :
+        curr(_curr),
         pred(std::forward<Pred>(_pred)) {
           this->next();
         }
@@ -576,33 +1765,299 @@ namespace bstb::fs {
     return filter_impl<std::filesystem::recursive_directory_iterator, Fn>(path, std::forward<Fn>(filter));
   }
 
+  // Walks `root` on `threads` workers, each owning a deque of directories that idle
+  // workers steal from. Like recursive_filter, symlinked directories are not followed and
+  // every entry passing `filter` is returned, sorted by path so results are reproducible.
+  // The filter is called concurrently from all workers.
+  template <typename Fn>
+  inline auto parallel_recursive_filter(const path& root, Fn&& filter, size_t threads = sys::process::cpu_count()) -> std::vector<directory_entry> {
+    struct Worker {
+      std::mutex lock {};
+      std::deque<std::string> dirs {};
+      std::vector<directory_entry> found {};
+    };
+
+    const auto count = std::max<size_t>(threads, 1);
+    auto workers = std::vector<Worker>(count);
+    auto pending = std::atomic<size_t>{ 1 };
+    workers[0].dirs.push_back(root.native());
+
+    // Workers with nothing to steal sleep until directories are queued or the walk is done.
+    auto queued = std::atomic<size_t>{ 1 };
+    auto idle_lock = std::mutex{};
+    auto idle = std::condition_variable{};
+
+    const auto take = [&](size_t self) -> std::optional<std::string> {
+      for (size_t i = 0; i < count; ++i) {
+        auto& worker = workers[(self + i) % count];
+        auto guard = std::lock_guard{ worker.lock };
+        if (worker.dirs.empty()) {
+          continue;
+        }
+
+        auto dir = std::string{};
+        if (i == 0) {
+          dir = std::move(worker.dirs.back());
+          worker.dirs.pop_back();
+        } else {
+          dir = std::move(worker.dirs.front());
+          worker.dirs.pop_front();
+        }
+        queued.fetch_sub(1, std::memory_order_acq_rel);
+        return dir;
+      }
+      return std::nullopt;
+    };
+
+    const auto walk = [&](size_t self) {
+      auto& worker = workers[self];
+      while (pending.load(std::memory_order_acquire) != 0) {
+        auto dir = take(self);
+        if (!dir) {
+          auto guard = std::unique_lock{ idle_lock };
+          idle.wait(guard, [&] {
+            return queued.load(std::memory_order_acquire) != 0 || pending.load(std::memory_order_acquire) == 0;
+          });
+          continue;
+        }
+
+        // directory_iterator reads entries in large getdents batches and caches d_type,
+        // so neither the recursion check nor most filters need a stat per entry.
+        auto subdirs = std::vector<std::string>{};
+        auto ec = std::error_code{};
+        for (auto it = directory_iterator(*dir, ec); !ec && it != directory_iterator{}; it.increment(ec)) {
+          const auto& entry = *it;
+          auto entry_ec = std::error_code{};
+          if (!entry.is_symlink(entry_ec) && entry.is_directory(entry_ec)) {
+            subdirs.push_back(entry.path().native());
+          }
+
+          if (filter(entry)) {
+            worker.found.push_back(entry);
+          }
+        }
+
+        if (!subdirs.empty()) {
+          pending.fetch_add(subdirs.size(), std::memory_order_acq_rel);
+          {
+            auto guard = std::lock_guard{ idle_lock };
+            queued.fetch_add(subdirs.size(), std::memory_order_acq_rel);
+          }
+          {
+            auto guard = std::lock_guard{ worker.lock };
+            for (auto& subdir : subdirs) {
+              worker.dirs.push_back(std::move(subdir));
+            }
+          }
+          idle.notify_all();
+        }
+
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          auto guard = std::lock_guard{ idle_lock };
+          idle.notify_all();
+        }
+      }
+    };
+
+    auto pool = std::vector<std::thread>{};
+    for (size_t self = 1; self < count; ++self) {
+      pool.emplace_back(walk, self);
+    }
+    walk(0);
+    for (auto& thread : pool) {
+      thread.join();
+    }
+
+    auto entries = std::vector<directory_entry>{};
+    for (auto& worker : workers) {
+      std::move(worker.found.begin(), worker.found.end(), std::back_inserter(entries));
+    }
+    std::sort(entries.begin(), entries.end());
+    return entries;
+  }
+
+  inline auto parallel_recursive_iter(const path& root, size_t threads = sys::process::cpu_count()) -> std::vector<directory_entry> {
+    return parallel_recursive_filter(root, []([[maybe_unused]] auto&) { return true; }, threads);
+  }
+
+  // For unordered containers of paths, std::hash<path> is missing from older standard libraries.
+  struct Hash {
+    auto operator()(const path& _path) const noexcept -> size_t {
+      return hash_value(_path);
+    }
+  };
+
 } // namespace bstb::fs
 
+namespace bstb::hash {
+
+  inline auto hex(uint64_t value) -> std::string {
+    constexpr static char digits[] = "0123456789abcdef";
+    auto str = std::string(16, '0');
+    for (auto idx = str.rbegin(); idx != str.rend(); ++idx, value >>= 4) {
+      *idx = digits[value & 0xF];
+    }
+    return str;
+  }
+
+  inline auto file(const fs::path& path, Fnv& hasher) -> bool {
+    auto stream = std::ifstream(path, std::ios::in | std::ios::binary);
+    if (!stream) {
+      return false;
+    }
+
+    auto chunk = std::array<char, 1 << 16>{};
+    while (stream) {
+      stream.read(chunk.data(), chunk.size());
+      hasher.update(std::string_view{ chunk.data(), static_cast<size_t>(stream.gcount()) });
+    }
+    return true;
+  }
+
+} // namespace bstb::hash
+
 namespace bstb::embedder {
 
   namespace {
     constexpr inline size_t DefaultRowSize = 20;
 
+    // Inputs below this are encoded on the calling thread, spawning threads costs more.
+    constexpr inline size_t ParallelMinSize = 16 << 20;
+
     inline auto write_bytes_impl(char*& buf, char const* data, size_t size) -> void {
       std::memcpy(buf, data, size);
       buf += size;
     }
 
-    inline auto write_hex_impl(char*& buf, unsigned char const* data, size_t size, size_t row_size) -> void {
-      constexpr static char hex[] = "0123456789ABCDEF";
-      for (size_t i = 0; i < size; ++i) {
-        const auto byte = data[i];
-        *buf++ = '0';
-        *buf++ = 'x';
-        *buf++ = hex[(byte >> 4) & 0xF];
-        *buf++ = hex[byte & 0xF];
-        *buf++ = ',';
-        *buf++ = ' ';
-        if ((i + 1) % row_size == 0 && i != size - 1) {
+    constexpr static char HexDigits[] = "0123456789ABCDEF";
+    constexpr static size_t HexWidth = 6;
+
+    // "0xHH, " for every byte value, so the scalar path is a table lookup and a copy.
+    constexpr static auto HexTable = [] {
+      auto table = std::array<std::array<char, HexWidth>, 256>{};
+      for (size_t byte = 0; byte < table.size(); ++byte) {
+        table[byte] = { '0', 'x', HexDigits[byte >> 4], HexDigits[byte & 0xF], ',', ' ' };
+      }
+      return table;
+    }();
+
+    inline auto write_hex_scalar_impl(char* buf, unsigned char const* data, size_t size) -> void {
+      for (size_t i = 0; i < size; ++i, buf += HexWidth) {
+        std::memcpy(buf, HexTable[data[i]].data(), HexWidth);
+      }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Encodes 16 bytes into 96 characters per iteration. Each 16 character output chunk
+    // gathers the high and low digits it needs with pshufb and ors in the constant text.
+    struct HexMasks {
+      alignas(16) unsigned char high[HexWidth][16];
+      alignas(16) unsigned char low[HexWidth][16];
+      alignas(16) unsigned char text[HexWidth][16];
+    };
+
+    constexpr static auto HexShuffle = [] {
+      auto masks = HexMasks{};
+      for (size_t chunk = 0; chunk < HexWidth; ++chunk) {
+        for (size_t pos = 0; pos < 16; ++pos) {
+          const auto idx = chunk * 16 + pos;
+          const auto byte = static_cast<unsigned char>(idx / HexWidth);
+          const auto col = idx % HexWidth;
+          constexpr char text[] = { '0', 'x', 0, 0, ',', ' ' };
+
+          masks.high[chunk][pos] = col == 2 ? byte : 0x80;
+          masks.low[chunk][pos] = col == 3 ? byte : 0x80;
+          masks.text[chunk][pos] = text[col];
+        }
+      }
+      return masks;
+    }();
+
+    __attribute__((target("ssse3")))
+    inline auto write_hex_ssse3_impl(char* buf, unsigned char const* data, size_t size) -> void {
+      const auto digits = _mm_loadu_si128(reinterpret_cast<__m128i const*>(HexDigits));
+      const auto nibble = _mm_set1_epi8(0x0F);
+
+      size_t i = 0;
+      for (; i + 16 <= size; i += 16, buf += 16 * HexWidth) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+        const auto high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        const auto low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, nibble));
+
+        for (size_t chunk = 0; chunk < HexWidth; ++chunk) {
+          const auto text = _mm_load_si128(reinterpret_cast<__m128i const*>(HexShuffle.text[chunk]));
+          const auto from_high = _mm_shuffle_epi8(high, _mm_load_si128(reinterpret_cast<__m128i const*>(HexShuffle.high[chunk])));
+          const auto from_low = _mm_shuffle_epi8(low, _mm_load_si128(reinterpret_cast<__m128i const*>(HexShuffle.low[chunk])));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(buf + chunk * 16), _mm_or_si128(text, _mm_or_si128(from_high, from_low)));
+        }
+      }
+
+      write_hex_scalar_impl(buf, data + i, size - i);
+    }
+#endif
+
+    using HexKernel = void (*)(char*, unsigned char const*, size_t);
+
+    inline auto hex_kernel_impl() -> HexKernel {
+#if defined(__x86_64__) || defined(__i386__)
+      static const auto kernel = __builtin_cpu_supports("ssse3") ? HexKernel{ write_hex_ssse3_impl } : HexKernel{ write_hex_scalar_impl };
+      return kernel;
+#else
+      return write_hex_scalar_impl;
+#endif
+    }
+
+    inline auto write_rows_impl(char*& buf, unsigned char const* data, size_t size, size_t row_size, HexKernel kernel) -> void {
+      for (size_t i = 0; i < size; i += row_size) {
+        const auto row = std::min(row_size, size - i);
+        kernel(buf, data + i, row);
+        buf += row * HexWidth;
+
+        if (i + row != size) {
           *buf++ = '\n';
           *buf++ = '\t';
         }
       }
+    }
+
+    // Every full row encodes to the same number of characters, so each thread can start
+    // writing its run of rows at a precomputed offset without touching its neighbours.
+    inline auto write_rows_parallel_impl(char*& buf, unsigned char const* data, size_t size, size_t row_size, HexKernel kernel, size_t threads) -> void {
+      const auto rows = (size + row_size - 1) / row_size;
+      const auto stride = row_size * HexWidth + 2;
+      const auto per_thread = (rows + threads - 1) / threads;
+
+      auto pool = std::vector<std::thread>{};
+      pool.reserve(threads);
+
+      for (size_t first = 0; first < rows; first += per_thread) {
+        const auto last = std::min(rows, first + per_thread);
+        pool.emplace_back([=] {
+          auto* out = buf + first * stride;
+          const auto begin = first * row_size;
+          const auto end = std::min(size, last * row_size);
+          write_rows_impl(out, data + begin, end - begin, row_size, kernel);
+
+          if (last != rows) {
+            *out++ = '\n';
+            *out++ = '\t';
+          }
+        });
+      }
+
+      for (auto& thread : pool) {
+        thread.join();
+      }
+
+      buf += size * HexWidth + (rows - 1) * 2;
+    }
+
+    inline auto write_hex_impl(char*& buf, unsigned char const* data, size_t size, size_t row_size, size_t threads = 1, HexKernel kernel = hex_kernel_impl()) -> void {
+      if (threads > 1 && size > row_size) {
+        write_rows_parallel_impl(buf, data, size, row_size, kernel, std::min(threads, (size + row_size - 1) / row_size));
+      } else {
+        write_rows_impl(buf, data, size, row_size, kernel);
+      }
 
       if (*(buf - 2) == ',') {
         *(buf - 2) = ' ';
@@ -638,7 +2093,8 @@ namespace bstb::embedder {
     const std::string_view end {};
   };
 
-  static auto embed_impl(const fs::path& read, const fs::path& write, size_t row_size, const Config& config) -> bool { 
+  // `threads` of 0 picks one thread per core for inputs of at least ParallelMinSize.
+  static auto embed_impl(const fs::path& read, const fs::path& write, size_t row_size, const Config& config, size_t threads = 0) -> bool { 
     const auto [
       begin,
       size_header,
@@ -654,8 +2110,8 @@ namespace bstb::embedder {
       data_footer.size() + end.size()
     );
 
-    const auto [read_map, read_map_err] = MMap::Read(read.c_str());
-    if (read_map_err) {
+    const auto [read_map, read_map_err] = MMap::Read(read.c_str(), { .advice = MMap::Sequential });
+    if (read_map_err || read_map.size == 0) {
       return false;
     }
 
@@ -683,7 +2139,11 @@ namespace bstb::embedder {
     }
 
     write_bytes_impl(write_data, data_header.data(), data_header.size());
-    write_hex_impl(write_data, read_data, read_map.size, row_size);
+    if (threads == 0) {
+      threads = read_map.size >= ParallelMinSize ? sys::process::cpu_count() : 1;
+    }
+
+    write_hex_impl(write_data, read_data, read_map.size, row_size, threads);
     write_bytes_impl(write_data, data_footer.data(), data_footer.size());
   
     write_bytes_impl(write_data, end.data(), end.size());
@@ -691,7 +2151,7 @@ namespace bstb::embedder {
     return true;
   }
 
-  inline auto cpp(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize) -> bool {
+  inline auto cpp(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize, size_t threads = 0) -> bool {
     return embed_impl(read_fname, write_fname, row_size, {
       .begin = "#ifndef BSTB_EMBED\n\t#error This is a bootstrab embed file, define BSTB_EMBED to use.\n#else\n",
       .size_header = "constexpr static unsigned long size = ",
@@ -699,10 +2159,10 @@ namespace bstb::embedder {
       .data_header = "template <typename T>\nconstexpr static T data[] = {\n\t",
       .data_footer = "\n};\n",
       .end = "#undef BSTB_EMBED\n#endif\n"
-    });
+    }, threads);
   }
 
-  inline auto c(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize) -> bool {
+  inline auto c(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize, size_t threads = 0) -> bool {
     return embed_impl(read_fname, write_fname, row_size, {
       .begin = "#ifndef BSTB_EMBED\n\t#error This is a bootstrab embed file, define BSTB_EMBED to use.\n#else\n",
       .size_header = "static const unsigned long size = ",
@@ -710,413 +2170,3249 @@ namespace bstb::embedder {
       .data_header = "static const unsigned char data[] = {\n\t",
       .data_footer = "\n};\n",
       .end = "#undef BSTB_EMBED\n#endif\n"
-    });
+    }, threads);
   }
  
-  inline auto py(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize) -> bool {
+  inline auto py(const fs::path& read_fname, const fs::path& write_fname, size_t row_size = DefaultRowSize, size_t threads = 0) -> bool {
     return embed_impl(read_fname, write_fname, row_size, {
       .data_header = "data = [\n\t",
       .data_footer = "\n]\n",
-    });
+    }, threads);
   }
 
-} // namespace bstb::embedder
+  namespace {
+    inline auto compress_impl(unsigned char const* data, size_t size) -> std::vector<unsigned char> {
+      constexpr static size_t HashBits = 16;
 
-namespace bstb {
+      auto out = std::vector<unsigned char>{};
+      out.reserve(size / 2 + 16);
 
-  template <typename T, typename U>
-  concept IterableOver = requires(T container) {
-    { *std::begin(container) } -> std::convertible_to<U>;
-    { *std::end(container) } -> std::convertible_to<U>;
-  };
+      const auto write_length = [&out](size_t length) {
+        for (; length >= 255; length -= 255) {
+          out.push_back(255);
+        }
+        out.push_back(static_cast<unsigned char>(length));
+      };
 
-  struct Future {
-    sys::process::Pid pid;
+      const auto load = [data](size_t pos) {
+        uint32_t value;
+        std::memcpy(&value, data + pos, sizeof(value));
+        return value;
+      };
 
-    inline auto wait() const -> Result<sys::process::Status> {
-      auto res = sys::process::wait(pid);
-      if (res == sys::process::FAILED) {
-        return { .err = { "Process did not execute properly." }};
-      }
+      const auto hash = [](uint32_t value) {
+        return (value * 2654435761u) >> (32 - HashBits);
+      };
 
-      return { res };
-    }
+      auto table = std::vector<uint32_t>(size_t{1} << HashBits, UINT32_MAX);
+      size_t anchor = 0;
+      size_t pos = 0;
 
-    inline auto completed() const -> bool {
-      return sys::process::completed(pid);
-    }
-  };
+      const auto emit = [&](size_t literals_end, size_t offset, size_t match) {
+        const auto literals = literals_end - anchor;
+        const auto match_code = match ? match - lz::MinMatch : 0;
+        out.push_back(static_cast<unsigned char>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(match_code, 15)));
+        if (literals >= 15) {
+          write_length(literals - 15);
+        }
+        out.insert(out.end(), data + anchor, data + literals_end);
 
-  struct TaskList {
-    std::vector<Future> tasks;
+        if (match) {
+          out.push_back(static_cast<unsigned char>(offset & 0xFF));
+          out.push_back(static_cast<unsigned char>(offset >> 8));
+          if (match_code >= 15) {
+            write_length(match_code - 15);
+          }
+        }
+      };
 
-    auto push(Future future) -> void {
-      tasks.push_back(future);
-    }
+      while (size >= lz::MinMatch && pos + lz::MinMatch <= size) {
+        const auto value = load(pos);
+        auto& slot = table[hash(value)];
+        const auto candidate = slot;
+        slot = static_cast<uint32_t>(pos);
 
-    auto wait() -> void {
-      while (!tasks.empty()) {
-        auto it = tasks.begin();
-        while (it != tasks.end()) {
-          if (it->completed()) {
-            it = tasks.erase(it);
-          } else {
-            ++it;
-          }
+        if (candidate == UINT32_MAX || pos - candidate > lz::MaxOffset || load(candidate) != value) {
+          ++pos;
+          continue;
+        }
+
+        auto match = lz::MinMatch;
+        while (pos + match < size && data[candidate + match] == data[pos + match]) {
+          ++match;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        emit(pos, pos - candidate, match);
+        pos += match;
+        anchor = pos;
       }
+
+      emit(size, 0, 0);
+      return out;
     }
-  };
 
-  struct Config {
-    Pipe pipe = Pipe::Null();
-    bool verbose {};
-  };
+    // Writes a header with the compressed bytes and an accessor that inflates them on
+    // first use. With `compress` off the bytes are stored as is behind the same accessor.
+    inline auto compressed_impl(const fs::path& read, const fs::path& write, size_t row_size, bool compress) -> bool {
+      auto input = std::ifstream(read, std::ios::in | std::ios::binary);
+      if (!input) {
+        return false;
+      }
+      const auto raw = std::vector<unsigned char>(std::istreambuf_iterator<char>(input), {});
 
-  template <buffer::Buffer Buffer>
-  struct Command {
-    Buffer buffer; 
+      const auto payload = compress ? compress_impl(raw.data(), raw.size()) : raw;
 
-    template <typename Iter>
-    auto arg(Iter&& iter) -> void requires (IterableOver<Iter, std::string_view>) {
-      for (auto&& arg : iter) {
-        buffer.push(std::forward<std::decay_t<decltype(arg)>>(arg));
+      auto hex = std::string(payload.size() * HexWidth + (payload.size() / std::max<size_t>(row_size, 1) + 1) * 2, '\0');
+      auto* end = hex.data();
+      if (!payload.empty()) {
+        write_hex_impl(end, payload.data(), payload.size(), row_size);
       }
-    }
+      hex.resize(end - hex.data());
 
-    template <typename Iter>
-    auto arg(Iter&& iter) -> void requires (IterableOver<Iter, fs::directory_entry>) {
-      for (auto&& arg : iter) {
-        buffer.push(arg.path().c_str());
+      auto out = std::ofstream(write, std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!out) {
+        return false;
       }
-    } 
 
-    template <typename... Args>
-    auto arg(Args&&... args) -> void {
-      buffer.push(std::forward<Args>(args)...);
-    }
+      out << "#ifndef BSTB_EMBED\n\t#error This is a bootstrab embed file, define BSTB_EMBED to use.\n#else\n";
+      out << "#if !defined(BSTB_RT) && !defined(BSTB_IMPL)\n\t#error Compressed embeds need bootstrab.hpp included with BSTB_RT.\n#endif\n";
+      // Internal linkage like the other embeds, so two assets embedded under the same names
+      // in different translation units never resolve to each other.
+      out << "constexpr static unsigned long size = " << raw.size() << ";\n";
+      out << "constexpr static unsigned long stored_size = " << payload.size() << ";\n";
+      out << "constexpr static unsigned char stored[] = {\n\t" << hex << "\n};\n";
+      out << "template <typename T = unsigned char>\nstatic inline auto data() -> T const* {\n";
+      if (compress) {
+        out << "\tstatic const auto* bytes = ::bstb::lz::inflate_once(stored, stored_size, size);\n";
+      } else {
+        out << "\tconst auto* bytes = stored;\n";
+      }
+      out << "\treturn reinterpret_cast<T const*>(bytes);\n}\n";
+      out << "#undef BSTB_EMBED\n#endif\n";
 
-    template <typename T>
-    auto arg(T&& path) -> void requires (
-      std::same_as<std::remove_cvref_t<T>, fs::path>
-    ) {
-      buffer.push(path.c_str());
+      return static_cast<bool>(out);
     }
 
-    auto exec(const Config& config) -> Result<sys::process::Pid> {
-      if (config.verbose) {
-        std::cout << buffer << std::endl;
+    // Writes a header that pulls the file in with #embed where the compiler has it, and
+    // otherwise with an .incbin in a top level asm block. Either way the compiler never
+    // parses a byte array, it only sees the path. The asm symbol sits in a COMDAT group
+    // so including the header from several translation units keeps a single copy.
+    inline auto incbin_impl(const fs::path& read, const fs::path& write, bool cpp) -> bool {
+      auto ec = std::error_code{};
+      const auto source = fs::absolute(read, ec);
+      const auto size = fs::file_size(source, ec);
+      if (ec) {
+        return false;
       }
 
-      const auto* exec_args = buffer.exec_args();
+      auto quoted = std::string{ "\"" };
+      for (const auto ch : source.native()) {
+        if (ch == '"' || ch == '\\') {
+          quoted += '\\';
+        }
+        quoted += ch;
+      }
+      quoted += '"';
 
-      const auto pid = sys::process::exec(
-        config.pipe.read,
-        config.pipe.write,
-        exec_args[0],
-        exec_args
-      );
+      const auto symbol = "bstb_embed_" + hash::hex(hash::Fnv{}.update(source.native()).digest());
 
-      if (pid == sys::process::FAILED) {
-        return { .err = { "Failed to execute Command." } };
+      auto asm_quoted = std::string{};
+      for (const auto ch : quoted) {
+        if (ch == '"' || ch == '\\') {
+          asm_quoted += '\\';
+        }
+        asm_quoted += ch;
       }
 
-      return { pid };
-    }
-
-    inline auto run(const Config& config) -> Result<sys::process::Status> {  
-      const auto status = sys::process::wait(this->exec(config));
-      if (status == sys::process::FAILED) {
-        return { .err { "Process did not complete." }};
+      auto out = std::ofstream(write, std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!out) {
+        return false;
       }
 
-      return {{ status }};
-    }
+      out << "#ifndef BSTB_EMBED\n\t#error This is a bootstrab embed file, define BSTB_EMBED to use.\n#else\n";
+      out << (cpp ? "constexpr static unsigned long size = " : "static const unsigned long size = ") << size << ";\n";
 
-    inline auto run_async(const Config& config) -> Result<Future> {
-      const auto [pid, err] = this->exec(config);
-      if (err) {
-        return { .err = err };
+      out << "#if defined(__has_embed)\n#if __has_embed(" << quoted << ")\n#define BSTB_EMBED_DIRECTIVE\n#endif\n#endif\n";
+      out << "#ifdef BSTB_EMBED_DIRECTIVE\n";
+      if (cpp) {
+        out << "template <typename T>\nconstexpr static T data[] = {\n#embed " << quoted << "\n};\n";
+      } else {
+        out << "static const unsigned char data[] = {\n#embed " << quoted << "\n};\n";
+      }
+      out << "#undef BSTB_EMBED_DIRECTIVE\n#else\n";
+
+      out << "__asm__(\n";
+      out << "#if defined(__APPLE__)\n";
+      out << "\t\".section __TEXT,__const\\n\"\n";
+      out << "\t\".globl _" << symbol << "\\n\"\n";
+      out << "\t\".weak_definition _" << symbol << "\\n\"\n";
+      out << "\t\".p2align 4\\n\"\n";
+      out << "\t\"_" << symbol << ":\\n\"\n";
+      out << "#else\n";
+      out << "\t\".pushsection .rodata." << symbol << ",\\\"aG\\\",%progbits," << symbol << ",comdat\\n\"\n";
+      out << "\t\".weak " << symbol << "\\n\"\n";
+      out << "\t\".type " << symbol << ", %object\\n\"\n";
+      out << "\t\".balign 16\\n\"\n";
+      out << "\t\"" << symbol << ":\\n\"\n";
+      out << "#endif\n";
+      out << "\t\".incbin " << asm_quoted << "\\n\"\n";
+      out << "\t\".byte 0\\n\"\n";
+      out << "#if !defined(__APPLE__)\n";
+      out << "\t\".popsection\\n\"\n";
+      out << "#endif\n";
+      out << ");\n";
+
+      if (cpp) {
+        out << "extern \"C\" const unsigned char " << symbol << "[];\n";
+        out << "template <typename T>\ninline static T const* const data = reinterpret_cast<T const*>(" << symbol << ");\n";
+      } else {
+        out << "extern const unsigned char " << symbol << "[];\n";
+        out << "static const unsigned char* const data = " << symbol << ";\n";
       }
+      out << "#endif\n#undef BSTB_EMBED\n#endif\n";
 
-      return {{ pid }};
+      return static_cast<bool>(out);
     }
-  };
+  } // namespace private
 
-  template <buffer::Buffer Buffer = buffer::Default, typename... Args>
-  [[nodiscard]]
-  inline auto cmd(Args&&... args) -> Command<Buffer> {
-    auto command = Command<Buffer> { Buffer{} }; 
-    (command.arg(std::forward<Args>(args)), ...);
-    return command;
-  }
+  // Packs every regular file of `entries` (e.g. from fs::filter or fs::recursive_filter over
+  // `root`) into one blob, named by their path relative to `root`. Read it back with
+  // Pack::Open or embed it once and use Pack::View.
+  template <typename Range>
+  inline auto pack(const fs::path& root, Range&& entries, const fs::path& write_fname) -> bool {
+    struct File {
+      std::string name;
+      fs::path path;
+      uint64_t size;
+      uint64_t hashed;
+    };
 
-  template <size_t Cap, typename... Args>
-  [[nodiscard]]
-  inline auto cmd(Args&&... args) -> Command<buffer::StackBuffer<Cap>> {
-    return cmd<buffer::StackBuffer<Cap>>(std::forward<Args>(args)...);
-  }
+    auto files = std::vector<File>{};
+    auto ec = std::error_code{};
+    for (const auto& entry : entries) {
+      if (!entry.is_regular_file(ec)) {
+        continue;
+      }
+      auto name = fs::relative(entry.path(), root, ec).generic_string();
+      const auto hashed = Pack::hash(name);
+      files.push_back({ std::move(name), entry.path(), entry.file_size(ec), hashed });
+    }
 
+    if (files.size() > UINT32_MAX) {
+      return false;
+    }
+    const auto count = static_cast<uint32_t>(files.size());
 
-} // namespace bstb
+    // Hash and displace: the fullest buckets pick a seed first, each bucket takes the
+    // first seed that sends all of its names to free slots.
+    auto buckets = std::vector<std::vector<uint32_t>>(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      buckets[Pack::bucket(files[i].hashed, count)].push_back(i);
+    }
 
-namespace bstb::compiler::impl {
+    auto order = std::vector<uint32_t>(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+      return buckets[lhs].size() > buckets[rhs].size();
+    });
 
-  template <buffer::Buffer Buffer>
-  struct GNU {
-    using Cmd = Command<Buffer>;
+    auto seeds = std::vector<uint32_t>(count);
+    auto slots = std::vector<uint32_t>(count, UINT32_MAX);
+    auto taken = std::vector<uint32_t>{};
 
-    template <typename T>
-    constexpr static auto arg(Cmd& cmd, T&& arg) -> void {
-      cmd.arg(std::forward<T>(arg));
-    }
+    for (const auto bucket : order) {
+      if (buckets[bucket].empty()) {
+        break;
+      }
 
-    template <typename T>
-    constexpr static auto input(Cmd& cmd, T&& arg) -> void {
-      cmd.arg(std::forward<T>(arg));
-    }
+      auto placed = false;
+      for (uint32_t seed = 0; seed < (1u << 24) && !placed; ++seed) {
+        taken.clear();
+        placed = true;
+        for (const auto file : buckets[bucket]) {
+          const auto slot = Pack::slot(files[file].hashed, seed, count);
+          if (slots[slot] != UINT32_MAX || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+            placed = false;
+            break;
+          }
+          taken.push_back(slot);
+        }
 
-    template <typename T>
-    constexpr static auto output(Cmd& cmd, T&& arg) -> void {
-      cmd.arg("-o");
-      cmd.arg(std::forward<T>(arg));
-    }
+        if (placed) {
+          seeds[bucket] = seed;
+          for (size_t i = 0; i < taken.size(); ++i) {
+            slots[taken[i]] = buckets[bucket][i];
+          }
+        }
+      }
 
-    constexpr static auto version(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-std=", str);
+      if (!placed) {
+        return false;
+      }
     }
 
-    constexpr static auto warn(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-W", str);
-    }
+    const auto align = [](uint64_t offset, uint64_t to) {
+      return (offset + to - 1) / to * to;
+    };
 
-    constexpr static auto define(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-D", str);
+    auto header = Pack::Header{};
+    std::memcpy(header.magic, Pack::Magic, sizeof(Pack::Magic));
+    header.version = Pack::Version;
+    header.count = count;
+    header.seeds = sizeof(Pack::Header);
+    header.entries = align(header.seeds + count * sizeof(uint32_t), alignof(Pack::Entry));
+
+    auto table = std::vector<Pack::Entry>(count);
+    auto offset = header.entries + count * sizeof(Pack::Entry);
+    for (uint32_t slot = 0; slot < count; ++slot) {
+      const auto& file = files[slots[slot]];
+      table[slot].name = offset;
+      table[slot].name_size = file.name.size();
+      offset += file.name.size();
     }
-
-    template <typename T>
-    constexpr static auto include_path(Cmd& cmd, T&& arg) -> void {
-      cmd.arg("-I", std::forward<T>(arg));
+    for (uint32_t slot = 0; slot < count; ++slot) {
+      offset = align(offset, Pack::Align);
+      table[slot].data = offset;
+      table[slot].data_size = files[slots[slot]].size;
+      offset += files[slots[slot]].size;
     }
 
-    template <typename T>
-    constexpr static auto link_path(Cmd& cmd, T&& str) -> void {
-      cmd.arg("-L", str);
+    auto out = std::ofstream(write_fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
     }
 
-    template <typename T>
-    constexpr static auto link(Cmd& cmd, T&& str) -> void {
-      cmd.arg("-l", str);
-    }
+    auto written = uint64_t{};
+    const auto put = [&](void const* data, size_t size) {
+      out.write(static_cast<char const*>(data), size);
+      written += size;
+    };
+    const auto pad = [&](uint64_t to) {
+      constexpr static char zeros[Pack::Align] {};
+      put(zeros, to - written);
+    };
 
-    constexpr static auto opt(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-O", str);
+    put(&header, sizeof(header));
+    put(seeds.data(), seeds.size() * sizeof(uint32_t));
+    pad(header.entries);
+    put(table.data(), table.size() * sizeof(Pack::Entry));
+    for (uint32_t slot = 0; slot < count; ++slot) {
+      put(files[slots[slot]].name.data(), files[slots[slot]].name.size());
     }
 
-    constexpr static auto debug_info(Cmd& cmd) -> void {
-      cmd.arg("-g");
+    for (uint32_t slot = 0; slot < count; ++slot) {
+      pad(table[slot].data);
+      if (table[slot].data_size == 0) {
+        continue;
+      }
+      auto input = std::ifstream(files[slots[slot]].path, std::ios::in | std::ios::binary);
+      out << input.rdbuf();
+      written += table[slot].data_size;
     }
 
-    constexpr static auto no_exe(Cmd& cmd) -> void {
-      cmd.arg("-c");
-    }
+    return static_cast<bool>(out);
+  }
 
-    constexpr static auto feature(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-f", str);
-    }
+  // Embeds the file LZ compressed. `data<T>()` inflates it once on first use into a buffer
+  // kept for the rest of the program, `size` is the uncompressed size.
+  inline auto compressed_cpp(const fs::path& read_fname, const fs::path& write_fname, bool compress = true, size_t row_size = DefaultRowSize) -> bool {
+    return compressed_impl(read_fname, write_fname, row_size, compress);
+  }
 
-    constexpr static auto arch(Cmd& cmd, std::string_view str) -> void {
-      cmd.arg("-m", str);
-    }
+  // Same `data`/`size` symbols as cpp(), but the bytes are assembled straight from the
+  // file instead of being parsed from a hex array. data<T> is only constexpr with #embed.
+  //
+  // The asset never goes through the preprocessor as an include, so depfiles list the
+  // header but not the asset. Run the embed as a Graph target with the asset as input and
+  // the header as output: the header is rewritten whenever the asset changes, and every
+  // compile that includes it is rebuilt through its depfile.
+  inline auto incbin_cpp(const fs::path& read_fname, const fs::path& write_fname) -> bool {
+    return incbin_impl(read_fname, write_fname, true);
+  }
+
+  inline auto incbin_c(const fs::path& read_fname, const fs::path& write_fname) -> bool {
+    return incbin_impl(read_fname, write_fname, false);
+  }
+
+} // namespace bstb::embedder
+
+namespace bstb::trace {
+
+  // Opt-in timeline of every command, written as Chrome trace events for Perfetto or
+  // chrome://tracing when the program exits. Enable it with start() or by setting
+  // BSTB_TRACE to the output path. Each thread buffers its events without taking any
+  // lock and hands them over in batches, when its buffer fills up, when the thread exits
+  // and when it calls flush().
+  enum class Kind : unsigned char {
+    Spawn,
+    Exit,
+    Wait,
   };
 
-}
+  struct Event {
+    Kind kind;
+    sys::process::Pid pid;
+    sys::process::Status status;
+    int64_t begin;
+    int64_t end;
+    std::string argv {};
+  };
 
-namespace bstb::compiler::style {
+  inline auto now() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
 
-  template <template <typename> typename T, buffer::Buffer Buffer>
-  struct C {
-    using Impl = T<Buffer>; 
-    
-    Command<Buffer> cmd;
+  inline auto write() -> void;
 
-    constexpr C(std::string_view name) {
-      cmd.arg(name);
-    }
+  struct Recorder {
+    std::atomic<bool> on {};
+    std::string path {};
+    int64_t epoch = now();
+    std::atomic<size_t> threads {};
+    std::mutex mutex {};
+    std::vector<std::pair<size_t, Event>> events {};
 
-    template <typename U>
-    constexpr auto arg(U&& arg) -> C& {
-      Impl::arg(cmd, std::forward<U>(arg));
-      return *this;
+    Recorder() {
+      if (const auto* path = sys::env::get("BSTB_TRACE")) {
+        this->path = path;
+        on = true;
+      }
     }
 
-    template <typename U>
-    constexpr auto input(U&& arg) -> C& {
-      Impl::input(cmd, std::forward<U>(arg));
-      return *this;
+    // Threads have handed over their buffers by now, thread locals go before statics.
+    ~Recorder() {
+      write();
     }
+  };
 
-    template <typename U>
-    constexpr auto output(U&& arg) -> C& {
-      Impl::output(cmd, std::forward<U>(arg));
-      return *this;
-    }
+  inline auto recorder() -> Recorder& {
+    static auto recorder = Recorder{};
+    return recorder;
+  }
 
-    constexpr auto version(std::string_view str) -> C& {
-      Impl::version(cmd, str);
-      return *this;
-    }
+  inline auto enabled() -> bool {
+    return recorder().on.load(std::memory_order_relaxed);
+  }
 
-    constexpr auto warn(std::string_view str) -> C& {
-      Impl::warn(cmd, str);
-      return *this;
-    }
+  inline auto start(std::string path = "bootstrab.trace.json") -> void {
+    auto& rec = recorder();
+    auto lock = std::lock_guard{ rec.mutex };
+    rec.path = std::move(path);
+    rec.on = true;
+  }
 
-    constexpr auto define(std::string_view str) -> C& {
-      Impl::define(cmd, str);
-      return *this;
-    }
+  struct Log {
+    constexpr static size_t Batch = 256;
 
-    template <typename U>
-    constexpr auto include_path(U&& str) -> C& {
-      Impl::include_path(cmd, std::forward<U>(str));
-      return *this;
-    }
+    size_t thread = recorder().threads.fetch_add(1, std::memory_order_relaxed);
+    std::vector<Event> events {};
 
-    template <typename U>
-    constexpr auto link_path(U&& str) -> C& {
-      Impl::link_path(cmd, str);
-      return *this;
-    }
+    auto hand_over() -> void {
+      if (events.empty()) {
+        return;
+      }
 
-    template <typename U>
-    constexpr auto link(U&& str) -> C& {
-      Impl::link(cmd, str);
-      return *this;
+      auto& rec = recorder();
+      auto lock = std::lock_guard{ rec.mutex };
+      for (auto& event : events) {
+        rec.events.emplace_back(thread, std::move(event));
+      }
+      events.clear();
     }
 
-    constexpr auto opt(std::string_view str) -> C& {
-      Impl::opt(cmd, str);
-      return *this;
+    ~Log() {
+      this->hand_over();
     }
+  };
 
-    constexpr auto debug_info() -> C& {
-      Impl::debug_info(cmd);
-      return *this;
+  inline auto log() -> Log& {
+    thread_local auto log = Log{};
+    return log;
+  }
+
+  inline auto record(Event event) -> void {
+    auto& into = log();
+    into.events.push_back(std::move(event));
+    if (into.events.size() >= Log::Batch) {
+      into.hand_over();
     }
+  }
 
-    constexpr auto no_exe() -> C& {
-      Impl::no_exe(cmd);
-      return *this;
+  inline auto spawn(sys::process::Pid pid, CStr const* args, int64_t begin) -> void {
+    auto argv = std::string{};
+    for (size_t i = 0; args[i]; ++i) {
+      argv += i ? " " : "";
+      argv += args[i];
     }
+    record({ Kind::Spawn, pid, 0, begin, now(), std::move(argv) });
+  }
 
-    constexpr auto feature(std::string_view str) -> C& {
-      Impl::feature(cmd, str);
-      return *this;
+  inline auto exit(sys::process::Pid pid, sys::process::Status status) -> void {
+    const auto ts = now();
+    record({ Kind::Exit, pid, status, ts, ts });
+  }
+
+  inline auto wait(sys::process::Pid pid, int64_t begin) -> void {
+    record({ Kind::Wait, pid, 0, begin, now() });
+  }
+
+  namespace {
+    inline auto escape_impl(std::string& out, std::string_view str) -> void {
+      for (const auto c : str) {
+        if (c == '"' || c == '\\') {
+          out += '\\';
+          out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          char hex[8];
+          std::snprintf(hex, sizeof(hex), "\\u%04x", c);
+          out += hex;
+        } else {
+          out += c;
+        }
+      }
     }
+  } // namespace private
 
-    constexpr auto arch(std::string_view str) -> C& {
-      Impl::arch(cmd, str);
-      return *this;
+  // Pairs every spawn with its exit and packs the commands into as few lanes as possible,
+  // one lane for every command that was running at the same time. Runs at exit.
+  inline auto write() -> void {
+    auto& rec = recorder();
+    auto lock = std::lock_guard{ rec.mutex };
+    if (!rec.on || rec.path.empty()) {
+      return;
     }
-    
-    constexpr auto compile(const Config& config) -> decltype(auto) {
-      return cmd.run(config);
+
+    struct Span {
+      int64_t begin;
+      int64_t spawned;
+      int64_t end;
+      sys::process::Pid pid;
+      std::optional<sys::process::Status> status;
+      std::string_view argv;
+    };
+
+    auto events = std::vector<std::pair<size_t, Event const*>>{};
+    for (const auto& [thread, event] : rec.events) {
+      events.emplace_back(thread, &event);
     }
+    std::stable_sort(events.begin(), events.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.second->end < rhs.second->end;
+    });
 
-    constexpr auto compile_async(const Config& config) -> decltype(auto) {
-      return cmd.run_async(config);
+    const auto flushed = now();
+    auto spans = std::vector<Span>{};
+    auto open = std::unordered_map<sys::process::Pid, size_t>{};
+    for (const auto& [thread, event] : events) {
+      if (event->kind == Kind::Spawn) {
+        open[event->pid] = spans.size();
+        spans.push_back({ event->begin, event->end, flushed, event->pid, {}, event->argv });
+      } else if (event->kind == Kind::Exit) {
+        if (const auto it = open.find(event->pid); it != open.end()) {
+          spans[it->second].end = event->end;
+          spans[it->second].status = event->status;
+          open.erase(it);
+        }
+      }
     }
-  };
 
-} // namespace bstb::compiler::impl
+    std::stable_sort(spans.begin(), spans.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.begin < rhs.begin;
+    });
 
-namespace bstb::compiler::c {
+    const auto us = [](int64_t ns) {
+      return std::to_string(ns / 1000) + '.' + std::to_string(ns / 100 % 10);
+    };
 
-  template <buffer::Buffer Buffer>
-  using GCC = style::C<impl::GNU, Buffer>; 
+    auto out = std::string{ "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" };
+    out += "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"commands\"}},\n";
+    out += "{\"ph\":\"M\",\"pid\":2,\"name\":\"process_name\",\"args\":{\"name\":\"waits\"}}";
 
-  template <buffer::Buffer Buffer = buffer::Default> 
-  [[nodiscard]]
-  constexpr auto gcc() -> GCC<Buffer> {
-    return { "gcc" };
-  }
+    auto lanes = std::vector<int64_t>{};
+    for (const auto& span : spans) {
+      auto lane = std::find_if(lanes.begin(), lanes.end(), [&](auto busy) { return busy <= span.begin; }) - lanes.begin();
+      if (static_cast<size_t>(lane) == lanes.size()) {
+        lanes.push_back(0);
+        out += ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(lane) + ",\"name\":\"thread_name\",\"args\":{\"name\":\"slot " + std::to_string(lane) + "\"}}";
+      }
+      lanes[lane] = span.end;
+
+      const auto name = span.argv.substr(0, span.argv.find(' '));
+      out += ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(lane) + ",\"ts\":" + us(span.begin - rec.epoch) + ",\"dur\":" + us(span.end - span.begin);
+      out += ",\"name\":\"";
+      escape_impl(out, name.substr(name.rfind('/') + 1));
+      out += "\",\"args\":{\"pid\":" + std::to_string(span.pid) + ",\"status\":" + (span.status ? std::to_string(*span.status) : "null");
+      out += ",\"spawn_us\":" + us(span.spawned - span.begin) + ",\"argv\":\"";
+      escape_impl(out, span.argv);
+      out += "\"}}";
+    }
 
-  template <buffer::Buffer Buffer>
-  using Clang = style::C<impl::GNU, Buffer>;
+    for (const auto& [thread, event] : events) {
+      if (event->kind == Kind::Wait) {
+        out += ",\n{\"ph\":\"X\",\"pid\":2,\"tid\":" + std::to_string(thread) + ",\"ts\":" + us(event->begin - rec.epoch) + ",\"dur\":" + us(event->end - event->begin);
+        out += ",\"name\":\"wait " + std::to_string(event->pid) + "\"}";
+      }
+    }
+    out += "\n]}\n";
 
-  template <buffer::Buffer Buffer = buffer::Default>
-  [[nodiscard]]
-  constexpr auto clang() -> Clang<Buffer> {
-    return { "clang" };
+    auto file = std::ofstream(rec.path, std::ios::out | std::ios::binary | std::ios::trunc);
+    file << out;
   }
 
-} // namespace bstb::compiler::c
+  // Writes the trace now, e.g. before an exec that skips the write at exit. Events still
+  // buffered by other running threads are left for a later write.
+  inline auto flush() -> void {
+    log().hand_over();
+    write();
+  }
 
-namespace bstb::compiler::cpp {
+} // namespace bstb::trace
 
-  template <buffer::Buffer Buffer>
-  using GCC = style::C<impl::GNU, Buffer>; 
+namespace bstb {
 
-  template <buffer::Buffer Buffer = buffer::Default>
-  [[nodiscard]]
-  constexpr auto gcc() -> GCC<Buffer> {
-    return { "g++" };
-  } 
+  template <typename T, typename U>
+  concept IterableOver = requires(T container) {
+    { *std::begin(container) } -> std::convertible_to<U>;
+    { *std::end(container) } -> std::convertible_to<U>;
+  };
 
-  template <buffer::Buffer Buffer>
-  using Clang = style::C<impl::GNU, Buffer>;
+  struct Capture {
+    std::string out {};
+    std::string err {};
+  };
 
-  template <buffer::Buffer Buffer = buffer::Default>
-  [[nodiscard]]
-  constexpr auto clang() -> Clang<Buffer> {
-    return { "clang++" };
-  }
+  // An exit status together with what the process cost and, with Pipe::Capture, what it
+  // wrote. Converts to the plain status, so `status == 0` and friends keep working.
+  struct Exit {
+    sys::process::Status status;
+    sys::process::Usage usage {};
+    Capture captured {};
 
-} // namespace bstb::compiler::cpp
+    constexpr operator sys::process::Status() const {
+      return status;
+    }
+  };
 
-namespace bstb::compiler {
-  
+  namespace {
+    // Appends whatever a non-blocking capture pipe has to offer, growing the buffer in
+    // place so bytes are only copied once. Returns true once the writing end is closed.
+    inline auto drain_impl(sys::io::Fd fd, std::string& into) -> bool {
+      constexpr static size_t MinChunk = 1 << 12;
+      for (;;) {
+        const auto used = into.size();
+        into.resize(used + std::max(into.capacity() - used, MinChunk));
+
+        const auto count = sys::io::read_fd(fd, into.data() + used, into.size() - used);
+        into.resize(used + (count > 0 ? count : 0));
+
+        if (count == 0) {
+          return true;
+        }
+        if (count < 0) {
+          return errno != EAGAIN && errno != EWOULDBLOCK;
+        }
+      }
+    }
+  } // namespace private
 
-  #if defined(__clang__)
-    template <buffer::Buffer Buffer = buffer::Default>
-    [[nodiscard]]
-    constexpr auto native() -> decltype(auto) { return cpp::clang<Buffer>(); }
-  #elif defined(__GNUC__) || defined(__GNUG__) || defined(__MINGW32__) || defined(__MINGW64__)
-    template <buffer::Buffer Buffer = buffer::Default>
-    [[nodiscard]]
-    constexpr auto native() -> decltype(auto) { return cpp::gcc<Buffer>(); }
-    
-  #endif
+  struct Finished;
 
-} // namespace bstb::compiler
+  // A running process and, when its output is captured, the read ends of its pipes.
+  // Futures own those pipes, so they only move: into a TaskList, or into finish().
+  struct Future {
+    sys::process::Pid pid;
+    OwnedFd out {};
+    OwnedFd err {};
+    bool skip {};
 
-namespace bstb {
+    // Called with the exit status by whatever reaps the process, wait() or a TaskList.
+    std::function<void(sys::process::Status)> reaped {};
 
-inline auto rebuild(std::string_view input, std::span<char*>&& args) -> void {
-    const auto* target = args[0]; 
+    // A future for work that was skipped, e.g. an object that was already up to date.
+    static inline auto Skipped() -> Future {
+      return { 0, {}, {}, true };
+    }
 
-    if (fs::modified_after(target, input)) {
-      return;
+    inline auto skipped() const -> bool {
+      return skip;
     }
 
-    std::cout << "Change detected. Rebuilding...\n";
+    // False for the empty future that comes with a failed spawn.
+    inline auto spawned() const -> bool {
+      return pid > 0;
+    }
 
-    auto [status, err] = compiler::native<buffer::StackBuffer<100>>()
+    inline auto captured() const -> bool {
+      return out.valid() || err.valid();
+    }
+
+    // Captured output is read along the way, a child filling its pipe would never exit
+    // otherwise, and comes back with the status.
+    inline auto wait() -> Result<Exit>;
+
+    inline auto completed() const -> bool {
+      return this->skipped() || sys::process::completed(pid);
+    }
+
+    // Reads captured output until both streams are closed, then reaps the process.
+    // The capture pipes are closed afterwards.
+    inline auto finish() -> Result<Finished>;
+  };
+
+  struct Finished {
+    Future future;
+    sys::process::Status status;
+    Capture captured {};
+    sys::process::Usage usage {};
+  };
+
+  inline auto Future::wait() -> Result<Exit> {
+    if (this->skipped()) {
+      return { 0 };
+    }
+
+    if (!this->spawned()) {
+      return { .err = { "Future has no process." } };
+    }
+
+    if (this->captured()) {
+      auto [finished, err] = this->finish();
+      if (err) {
+        return { .err = err };
+      }
+      return {{ finished.status, finished.usage, std::move(finished.captured) }};
+    }
+
+    const auto traced = trace::enabled();
+    const auto begin = traced ? trace::now() : 0;
+
+    auto usage = sys::process::Usage{};
+    auto res = sys::process::wait(pid, &usage);
+    if (traced) {
+      trace::wait(pid, begin);
+      trace::exit(pid, res);
+    }
+    if (reaped) {
+      std::exchange(reaped, {})(res);
+    }
+
+    if (res == sys::process::FAILED) {
+      return { .err = { "Process did not execute properly." }};
+    }
+
+    return {{ res, usage }};
+  }
+
+  inline auto Future::finish() -> Result<Finished> {
+    auto captured = Capture{};
+
+    OwnedFd streams[] = { std::move(out), std::move(err) };
+    std::string* buffers[] = { &captured.out, &captured.err };
+
+    for (;;) {
+      sys::io::Fd fds[2];
+      size_t owners[2];
+      size_t count = 0;
+      for (size_t i = 0; i < 2; ++i) {
+        if (streams[i].valid()) {
+          owners[count] = i;
+          fds[count++] = streams[i].get();
+        }
+      }
+
+      if (count == 0) {
+        break;
+      }
+
+      bool ready[2] {};
+      if (sys::io::wait_readable(fds, count, -1, ready) == sys::io::FAILED) {
+        break;
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+        if (ready[i] && drain_impl(fds[i], *buffers[owners[i]])) {
+          streams[owners[i]].reset();
+        }
+      }
+    }
+
+    const auto [done, err] = this->wait();
+    if (err) {
+      return { .err = err };
+    }
+
+    return {{ { pid }, done.status, std::move(captured), done.usage }};
+  }
+
+  struct TaskList {
+    struct Slot {
+      OwnedFd handle {};
+      OwnedFd out {};
+      OwnedFd err {};
+      Capture captured {};
+    };
+
+    enum Stream : unsigned long long {
+      Exit,
+      Out,
+      Err,
+    };
+
+    std::vector<Future> tasks;
+    std::vector<Slot> slots {};
+    OwnedFd poller {};
+    int64_t waiting {};
+
+    auto push(Future future) -> bstb::Err {
+      if (!future.skipped() && !future.spawned()) {
+        return { "Future has no process." };
+      }
+
+      tasks.push_back(std::move(future));
+      return {};
+    }
+
+    auto size() const -> size_t {
+      return tasks.size();
+    }
+
+    auto empty() const -> bool {
+      return tasks.empty();
+    }
+
+    constexpr static auto key(sys::process::Pid pid, Stream stream) -> unsigned long long {
+      return static_cast<unsigned long long>(pid) | (stream << 32);
+    }
+
+    // Registers a pidfd and the capture pipes of every task pushed since the last call,
+    // taking ownership of the pipes. Tasks whose pidfd could not be opened keep an
+    // invalid handle and are reaped by polling instead.
+    auto arm() -> bool {
+      if (!poller.valid()) {
+        poller.reset(sys::event::create());
+      }
+
+      for (auto idx = slots.size(); idx < tasks.size(); ++idx) {
+        auto& task = tasks[idx];
+        auto& slot = slots.emplace_back();
+        slot.out = std::move(task.out);
+        slot.err = std::move(task.err);
+
+        if (task.skipped() || !poller.valid()) {
+          continue;
+        }
+
+        slot.handle.reset(sys::process::open_handle(task.pid));
+        if (slot.handle.valid() && sys::event::add(poller.get(), slot.handle.get(), key(task.pid, Exit)) == sys::io::FAILED) {
+          slot.handle.reset();
+        }
+
+        if (slot.out.valid()) {
+          sys::event::add(poller.get(), slot.out.get(), key(task.pid, Out));
+        }
+        if (slot.err.valid()) {
+          sys::event::add(poller.get(), slot.err.get(), key(task.pid, Err));
+        }
+      }
+
+      auto armed = poller.valid();
+      for (size_t idx = 0; idx < slots.size(); ++idx) {
+        armed = armed && (slots[idx].handle.valid() || tasks[idx].skipped());
+      }
+      return armed;
+    }
+
+    auto drain(size_t idx) -> void {
+      auto& slot = slots[idx];
+      if (slot.out.valid() && drain_impl(slot.out.get(), slot.captured.out)) {
+        slot.out.reset();
+      }
+      if (slot.err.valid() && drain_impl(slot.err.get(), slot.captured.err)) {
+        slot.err.reset();
+      }
+    }
+
+    auto reap(size_t idx) -> Result<Finished> {
+      auto status = sys::process::Status{};
+      auto usage = sys::process::Usage{};
+      if (!tasks[idx].skipped() && !sys::process::try_wait(tasks[idx].pid, status, &usage)) {
+        return { .err = { "Task is still running." } };
+      }
+
+      if (!tasks[idx].skipped() && trace::enabled()) {
+        if (waiting) {
+          trace::wait(tasks[idx].pid, std::exchange(waiting, 0));
+        }
+        trace::exit(tasks[idx].pid, status);
+      }
+      if (tasks[idx].reaped) {
+        std::exchange(tasks[idx].reaped, {})(status);
+      }
+
+      // Whatever the child wrote before exiting is still sitting in its pipes.
+      this->drain(idx);
+
+      auto finished = Finished{ { tasks[idx].pid }, status, std::move(slots[idx].captured), usage };
+      std::swap(tasks[idx], tasks.back());
+      std::swap(slots[idx], slots.back());
+      tasks.pop_back();
+      slots.pop_back();
+
+      return { std::move(finished) };
+    }
+
+    // Kills and reaps every task still running, so none of them outlives a failed build.
+    auto cancel() -> void {
+      for (const auto& task : tasks) {
+        if (task.spawned()) {
+          sys::process::kill(task.pid);
+          sys::process::wait(task.pid);
+        }
+      }
+      tasks.clear();
+      slots.clear();
+    }
+
+    auto wait_any() -> Result<Finished> {
+      if (tasks.empty()) {
+        return { .err = { "No tasks to wait on." } };
+      }
+
+      // Traced as a wait on whichever task finishes first.
+      waiting = trace::enabled() ? trace::now() : 0;
+
+      const auto armed = this->arm();
+
+      for (size_t idx = 0; idx < tasks.size(); ++idx) {
+        if (tasks[idx].skipped()) {
+          return this->reap(idx);
+        }
+      }
+
+      if (!armed) {
+        for (;;) {
+          for (size_t idx = 0; idx < tasks.size(); ++idx) {
+            this->drain(idx);
+            if (auto res = this->reap(idx); !res) {
+              return res;
+            }
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+
+      for (;;) {
+        auto events = std::array<sys::event::Event, 16>{};
+        const auto count = sys::event::wait(poller.get(), events.data(), events.size(), -1);
+        if (count == sys::io::FAILED) {
+          return { .err = { "Failed to wait on task events." } };
+        }
+
+        for (int i = 0; i < count; ++i) {
+          const auto event_key = sys::event::key(events[i]);
+          const auto pid = static_cast<sys::process::Pid>(event_key & 0xFFFFFFFF);
+          const auto stream = static_cast<Stream>(event_key >> 32);
+
+          for (size_t idx = 0; idx < tasks.size(); ++idx) {
+            if (tasks[idx].pid != pid) {
+              continue;
+            }
+
+            if (stream != Exit) {
+              this->drain(idx);
+            } else if (auto res = this->reap(idx); !res) {
+              return res;
+            }
+            break;
+          }
+        }
+      }
+    }
+
+    auto wait_all() -> std::vector<Finished> {
+      auto finished = std::vector<Finished>{};
+      finished.reserve(tasks.size());
+
+      while (!tasks.empty()) {
+        auto [done, err] = this->wait_any();
+        if (err) {
+          break;
+        }
+        finished.push_back(std::move(done));
+      }
+
+      return finished;
+    }
+
+    auto wait() -> void {
+      this->wait_all();
+    }
+  };
+
+  struct Config {
+    Pipe pipe = Pipe::Null();
+    bool verbose {};
+  };
+
+  namespace {
+    // Memoized PATH lookup so repeated launches of the same tool skip the directory probing
+    // posix_spawnp would otherwise redo every time. The cache resets whenever PATH changes.
+    struct ProgramCache {
+      std::string path {};
+      std::unordered_map<std::string, std::string> programs {};
+    };
+
+    inline auto program_cache_impl() -> ProgramCache& {
+      thread_local auto cache = ProgramCache{};
+      return cache;
+    }
+
+    inline auto resolve_impl(CStr program) -> CStr {
+      const auto* path = sys::env::get("PATH");
+      if (!path || std::strchr(program, '/')) {
+        return program;
+      }
+
+      auto& cache = program_cache_impl();
+      if (cache.path != path) {
+        cache.path = path;
+        cache.programs.clear();
+      }
+
+      auto [it, inserted] = cache.programs.try_emplace(program);
+      if (inserted) {
+        for (auto dirs = std::string_view{ cache.path }; ; ) {
+          const auto sep = dirs.find(':');
+          const auto dir = dirs.substr(0, sep);
+
+          auto candidate = std::string{ dir.empty() ? "." : dir } += '/';
+          candidate += program;
+          if (sys::process::executable(candidate.c_str())) {
+            it->second = std::move(candidate);
+            break;
+          }
+
+          if (sep == std::string_view::npos) {
+            break;
+          }
+          dirs.remove_prefix(sep + 1);
+        }
+      }
+
+      return it->second.empty() ? program : it->second.c_str();
+    }
+
+    inline auto forget_impl(CStr program) -> void {
+      program_cache_impl().programs.erase(program);
+    }
+  } // namespace private
+
+  template <buffer::Buffer Buffer>
+  struct Command {
+    Buffer buffer; 
+
+    template <typename Iter>
+    auto arg(Iter&& iter) -> void requires (IterableOver<Iter, std::string_view>) {
+      for (auto&& arg : iter) {
+        buffer.push(std::forward<std::decay_t<decltype(arg)>>(arg));
+      }
+    }
+
+    template <typename Iter>
+    auto arg(Iter&& iter) -> void requires (IterableOver<Iter, fs::directory_entry>) {
+      for (auto&& arg : iter) {
+        buffer.push(arg.path().c_str());
+      }
+    } 
+
+    template <typename... Args>
+    auto arg(Args&&... args) -> void {
+      buffer.push(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    auto arg(T&& path) -> void requires (
+      std::same_as<std::remove_cvref_t<T>, fs::path>
+    ) {
+      buffer.push(path.c_str());
+    }
+
+    auto exec(const Config& config) -> Result<Future> {
+      if (config.verbose) {
+        std::cout << buffer << std::endl;
+      }
+
+      const auto traced = trace::enabled();
+      const auto begin = traced ? trace::now() : 0;
+
+      const auto* exec_args = buffer.exec_args();
+      const auto* program = resolve_impl(exec_args[0]);
+
+      if (!config.pipe.capture) {
+        auto pid = sys::process::exec(
+          config.pipe.read,
+          config.pipe.write,
+          program,
+          exec_args
+        );
+
+        // A cached path can go stale when a tool is moved, retry with a fresh lookup.
+        if (pid == sys::process::FAILED && program != exec_args[0]) {
+          forget_impl(exec_args[0]);
+          pid = sys::process::exec(config.pipe.read, config.pipe.write, exec_args[0], exec_args);
+        }
+
+        if (pid == sys::process::FAILED) {
+          return { .err = { "Failed to execute Command." } };
+        }
+
+        if (traced) {
+          trace::spawn(pid, exec_args, begin);
+        }
+        return {{ pid }};
+      }
+
+      sys::io::Fd out[2], err[2];
+      if (sys::io::make_capture_pipe(out) == sys::io::FAILED) {
+        return { .err = { "Failed to create capture pipe." } };
+      }
+
+      auto out_read = OwnedFd(out[0]);
+      auto out_write = OwnedFd(out[1]);
+      if (sys::io::make_capture_pipe(err) == sys::io::FAILED) {
+        return { .err = { "Failed to create capture pipe." } };
+      }
+
+      auto err_read = OwnedFd(err[0]);
+      auto err_write = OwnedFd(err[1]);
+
+      auto pid = sys::process::exec(
+        config.pipe.read,
+        out_write.get(),
+        program,
+        exec_args,
+        err_write.get()
+      );
+
+      if (pid == sys::process::FAILED && program != exec_args[0]) {
+        forget_impl(exec_args[0]);
+        pid = sys::process::exec(config.pipe.read, out_write.get(), exec_args[0], exec_args, err_write.get());
+      }
+
+      if (pid == sys::process::FAILED) {
+        return { .err = { "Failed to execute Command." } };
+      }
+
+      if (traced) {
+        trace::spawn(pid, exec_args, begin);
+      }
+      return {{ pid, std::move(out_read), std::move(err_read) }};
+    }
+
+    inline auto run(const Config& config) -> Result<Exit> {  
+      auto [future, err] = this->exec(config);
+      if (err) {
+        return { .err = err };
+      }
+
+      auto [finished, finish_err] = future.finish();
+      if (finish_err) {
+        return { .err { "Process did not complete." }};
+      }
+
+      return {{ finished.status, finished.usage, std::move(finished.captured) }};
+    }
+
+    inline auto run_async(const Config& config) -> Result<Future> {
+      return this->exec(config);
+    }
+  };
+
+  template <buffer::Buffer Buffer = buffer::Default, typename... Args>
+  [[nodiscard]]
+  inline auto cmd(Args&&... args) -> Command<Buffer> {
+    auto command = Command<Buffer> { Buffer{} }; 
+    (command.arg(std::forward<Args>(args)), ...);
+    return command;
+  }
+
+  template <size_t Cap, typename... Args>
+  [[nodiscard]]
+  inline auto cmd(Args&&... args) -> Command<buffer::StackBuffer<Cap>> {
+    return cmd<buffer::StackBuffer<Cap>>(std::forward<Args>(args)...);
+  }
+
+  template <buffer::Literal... Args>
+  [[nodiscard]]
+  consteval auto cmd() -> Command<buffer::StaticBuffer<Args...>> {
+    return {};
+  }
+
+  template <typename... Args>
+  [[nodiscard]]
+  inline auto cmd(buffer::Arena& arena, Args&&... args) -> Command<buffer::ArenaBuffer> {
+    auto command = Command<buffer::ArenaBuffer> { buffer::ArenaBuffer{ &arena } };
+    (command.arg(std::forward<Args>(args)), ...);
+    return command;
+  }
+
+
+} // namespace bstb
+
+namespace bstb::compiler::impl {
+
+  template <buffer::Buffer Buffer>
+  struct GNU {
+    using Cmd = Command<Buffer>;
+
+    template <typename T>
+    constexpr static auto arg(Cmd& cmd, T&& arg) -> void {
+      cmd.arg(std::forward<T>(arg));
+    }
+
+    template <typename T>
+    constexpr static auto input(Cmd& cmd, T&& arg) -> void {
+      cmd.arg(std::forward<T>(arg));
+    }
+
+    template <typename T>
+    constexpr static auto output(Cmd& cmd, T&& arg) -> void {
+      cmd.arg("-o");
+      cmd.arg(std::forward<T>(arg));
+    }
+
+    constexpr static auto version(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-std=", str);
+    }
+
+    constexpr static auto warn(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-W", str);
+    }
+
+    constexpr static auto define(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-D", str);
+    }
+
+    template <typename T>
+    constexpr static auto include_path(Cmd& cmd, T&& arg) -> void {
+      cmd.arg("-I", std::forward<T>(arg));
+    }
+
+    template <typename T>
+    constexpr static auto link_path(Cmd& cmd, T&& str) -> void {
+      cmd.arg("-L", str);
+    }
+
+    template <typename T>
+    constexpr static auto link(Cmd& cmd, T&& str) -> void {
+      cmd.arg("-l", str);
+    }
+
+    constexpr static auto opt(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-O", str);
+    }
+
+    constexpr static auto debug_info(Cmd& cmd) -> void {
+      cmd.arg("-g");
+    }
+
+    constexpr static auto no_exe(Cmd& cmd) -> void {
+      cmd.arg("-c");
+    }
+
+    constexpr static auto feature(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-f", str);
+    }
+
+    constexpr static auto arch(Cmd& cmd, std::string_view str) -> void {
+      cmd.arg("-m", str);
+    }
+
+    // Flags as compile time literals, for commands built with cmd<"gcc", ...>().
+    template <buffer::Literal Str>
+    consteval static auto version() { return buffer::Literal{"-std="} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto warn() { return buffer::Literal{"-W"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto define() { return buffer::Literal{"-D"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto include_path() { return buffer::Literal{"-I"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto link_path() { return buffer::Literal{"-L"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto link() { return buffer::Literal{"-l"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto opt() { return buffer::Literal{"-O"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto feature() { return buffer::Literal{"-f"} + Str; }
+
+    template <buffer::Literal Str>
+    consteval static auto arch() { return buffer::Literal{"-m"} + Str; }
+
+    template <typename T>
+    constexpr static auto depfile(Cmd& cmd, T&& arg) -> void {
+      cmd.arg("-MMD");
+      cmd.arg("-MF");
+      cmd.arg(std::forward<T>(arg));
+    }
+
+    // GCC looks for `<header>.gch` next to a force included header and silently falls back
+    // to the header itself when it can't use it, clang looks for `<header>.pch`.
+    constexpr static auto pch_extension(std::string_view compiler) -> std::string_view {
+      return compiler.find("clang") != std::string_view::npos ? ".pch" : ".gch";
+    }
+
+    // Without a language the driver picks one from the header's extension, as it would
+    // for a source.
+    template <typename T>
+    constexpr static auto header(Cmd& cmd, std::string_view language, T&& arg) -> void {
+      if (!language.empty()) {
+        cmd.arg("-x");
+        if (language.ends_with("-header")) {
+          cmd.arg(language);
+        } else {
+          cmd.arg(language, "-header");
+        }
+      }
+      cmd.arg(std::forward<T>(arg));
+    }
+
+    template <typename T>
+    constexpr static auto force_include(Cmd& cmd, T&& arg) -> void {
+      cmd.arg("-include");
+      cmd.arg(std::forward<T>(arg));
+    }
+  };
+
+}
+
+namespace bstb::compiler {
+
+  // Content addressed object cache. Objects are keyed on the preprocessed source, the
+  // compiler binary and the compiler arguments, minus the ones that only name outputs.
+  struct Cache {
+    struct Stats {
+      uintmax_t hits;
+      uintmax_t misses;
+      uintmax_t size;
+    };
+
+    struct Pending {
+      std::string key;
+      fs::path output;
+      fs::path depfile;
+      sys::process::Pid pid;
+    };
+
+    fs::path dir = default_dir();
+    uintmax_t max_size = uintmax_t{5} << 30;
+    std::vector<Pending> pending {};
+
+    static inline auto default_dir() -> fs::path {
+      if (const auto* dir = sys::env::get("BSTB_CACHE_DIR")) {
+        return dir;
+      }
+      if (const auto* dir = sys::env::get("XDG_CACHE_HOME")) {
+        return fs::path(dir) / "bootstrab";
+      }
+      if (const auto* dir = sys::env::get("HOME")) {
+        return fs::path(dir) / ".cache" / "bootstrab";
+      }
+      return fs::temp_directory_path() / "bootstrab-cache";
+    }
+
+    template <buffer::Buffer Buffer>
+    auto key(Command<Buffer>& command) -> Result<std::string> {
+      auto hasher = hash::Fnv{};
+      auto preprocess = Command<buffer::HeapBuffer>{};
+
+      const auto* args = command.buffer.exec_args();
+      for (size_t i = 0; args[i]; ++i) {
+        const auto arg = std::string_view{ args[i] };
+        if ((arg == "-o" || arg == "-MF") && args[i + 1]) {
+          ++i;
+          continue;
+        }
+        if (arg == "-MMD") {
+          continue;
+        }
+
+        hasher.update(arg).update(std::string_view{ "\0", 1 });
+        if (arg != "-c") {
+          preprocess.arg(arg);
+        }
+      }
+
+      // `g++` names whichever compiler is installed, objects from an older one don't count.
+      const auto binary = sys::io::stat_path(resolve_impl(args[0]));
+      hasher.update(reinterpret_cast<unsigned char const*>(&binary.mtime), sizeof(binary.mtime));
+      hasher.update(reinterpret_cast<unsigned char const*>(&binary.size), sizeof(binary.size));
+
+      auto ec = std::error_code{};
+      fs::create_directories(dir / "tmp", ec);
+
+      static auto counter = 0;
+      const auto tmp = dir / "tmp" / (std::to_string(getpid()) + '.' + std::to_string(counter++) + ".i");
+      preprocess.arg("-E");
+      preprocess.arg("-o");
+      preprocess.arg(tmp);
+
+      const auto [status, err] = preprocess.run({});
+      const auto hashed = !err && status == 0 && hash::file(tmp, hasher);
+      fs::remove(tmp, ec);
+
+      if (!hashed) {
+        return { .err = { "Failed to preprocess source for cache key." } };
+      }
+
+      return { hash::hex(hasher.digest()) };
+    }
+
+    auto entry(std::string_view key, std::string_view ext) const -> fs::path {
+      return dir / key.substr(0, 2) / (std::string{ key.substr(2) } += ext);
+    }
+
+    // Links or copies a cached object to `output`. Returns false on a miss.
+    auto fetch(const std::string& key, const fs::path& output, const fs::path& depfile = {}) -> bool {
+      const auto object = this->entry(key, ".o");
+
+      auto ec = std::error_code{};
+      if (!fs::exists(object, ec) || (!depfile.empty() && !fs::exists(this->entry(key, ".d"), ec))) {
+        this->record(0, 1, 0);
+        return false;
+      }
+
+      fs::remove(output, ec);
+      fs::create_hard_link(object, output, ec);
+      if (ec && !fs::copy_file(object, output, fs::copy_options::overwrite_existing, ec)) {
+        this->record(0, 1, 0);
+        return false;
+      }
+
+      if (!depfile.empty()) {
+        fs::copy_file(this->entry(key, ".d"), depfile, fs::copy_options::overwrite_existing, ec);
+      }
+
+      fs::last_write_time(object, fs::file_time_type::clock::now(), ec);
+      this->record(1, 0, 0);
+      return true;
+    }
+
+    auto store(const std::string& key, const fs::path& output, const fs::path& depfile = {}) -> void {
+      const auto object = this->entry(key, ".o");
+      const auto tmp = dir / "tmp" / (key + '.' + std::to_string(getpid()));
+
+      auto ec = std::error_code{};
+      fs::create_directories(object.parent_path(), ec);
+      fs::create_directories(tmp.parent_path(), ec);
+
+      const auto size_of = [&ec](const fs::path& path) -> intmax_t {
+        const auto size = fs::file_size(path, ec);
+        return ec ? 0 : static_cast<intmax_t>(size);
+      };
+
+      auto size = -size_of(object) - size_of(this->entry(key, ".d"));
+
+      if (!fs::copy_file(output, tmp, fs::copy_options::overwrite_existing, ec)) {
+        return;
+      }
+      fs::rename(tmp, object, ec);
+
+      if (!depfile.empty() && fs::copy_file(depfile, tmp, fs::copy_options::overwrite_existing, ec)) {
+        fs::rename(tmp, this->entry(key, ".d"), ec);
+      }
+      size += size_of(object) + size_of(this->entry(key, ".d"));
+
+      if (this->record(0, 0, size).size > max_size) {
+        this->evict();
+      }
+    }
+
+    // Stores the object of an asynchronous miss once its compile is reaped, if it succeeded.
+    // compile_async() hooks this onto the future, so any way of reaping it reports here.
+    auto finished(sys::process::Pid pid, sys::process::Status status) -> void {
+      const auto it = std::find_if(pending.begin(), pending.end(), [pid](const auto& entry) {
+        return entry.pid == pid;
+      });
+      if (it == pending.end()) {
+        return;
+      }
+
+      if (status == 0) {
+        this->store(it->key, it->output, it->depfile);
+      }
+      pending.erase(it);
+    }
+
+    // Stores the objects of asynchronous misses that exited successfully but weren't reaped
+    // yet. Compiles still running stay pending, ones reaped without a report are dropped.
+    auto collect() -> void {
+      std::erase_if(pending, [this](const auto& entry) {
+        auto status = sys::process::Status{};
+        if (!sys::process::peek(entry.pid, status)) {
+          return false;
+        }
+        if (status == 0) {
+          this->store(entry.key, entry.output, entry.depfile);
+        }
+        return true;
+      });
+    }
+
+    // Drops the least recently used objects until the cache is back under 90% of max_size.
+    auto evict() -> void {
+      struct Entry {
+        fs::file_time_type time;
+        uintmax_t size;
+        fs::path path;
+      };
+
+      auto entries = std::vector<Entry>{};
+      auto total = uintmax_t{};
+      auto ec = std::error_code{};
+
+      for (const auto& file : fs::recursive_directory_iterator(dir, ec)) {
+        if (!file.is_regular_file(ec) || file.path().extension() != ".o") {
+          continue;
+        }
+        auto depfile = fs::path(file.path()).replace_extension(".d");
+        const auto size = file.file_size(ec) + (fs::exists(depfile, ec) ? fs::file_size(depfile, ec) : 0);
+        entries.push_back({ file.last_write_time(ec), size, file.path() });
+        total += size;
+      }
+
+      std::sort(entries.begin(), entries.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.time < rhs.time;
+      });
+
+      const auto target = max_size / 10 * 9;
+      for (const auto& [time, size, path] : entries) {
+        if (total <= target) {
+          break;
+        }
+        fs::remove(path, ec);
+        fs::remove(fs::path(path).replace_extension(".d"), ec);
+        total -= size;
+      }
+
+      this->record(0, 0, 0, total);
+    }
+
+    auto stats() -> Stats {
+      return this->record(0, 0, 0);
+    }
+
+    // Updates the shared counters under a file lock, other builds may use the same cache.
+    auto record(uintmax_t hits, uintmax_t misses, intmax_t size, std::optional<uintmax_t> total = {}) -> Stats {
+      auto ec = std::error_code{};
+      fs::create_directories(dir, ec);
+
+      auto stats = Stats{};
+      const auto fd = OwnedFd(sys::io::open_fd_write((dir / "stats").c_str()));
+      if (!fd.valid()) {
+        return stats;
+      }
+
+      sys::io::lock_fd(fd.get());
+
+      auto text = std::array<char, 128>{};
+      const auto count = sys::io::read_fd(fd.get(), text.data(), text.size() - 1);
+      if (count > 0) {
+        std::sscanf(text.data(), "%ju %ju %ju", &stats.hits, &stats.misses, &stats.size);
+      }
+
+      stats.hits += hits;
+      stats.misses += misses;
+      stats.size = total ? *total : (size < 0 && uintmax_t(-size) > stats.size) ? 0 : stats.size + size;
+
+      if (hits || misses || size || total) {
+        const auto len = std::snprintf(text.data(), text.size(), "%ju %ju %ju\n", stats.hits, stats.misses, stats.size);
+        sys::io::fd_truncate(fd.get(), 0);
+        pwrite(fd.get(), text.data(), len, 0);
+      }
+
+      sys::io::unlock_fd(fd.get());
+      return stats;
+    }
+
+    ~Cache() {
+      this->collect();
+    }
+  };
+
+} // namespace bstb::compiler
+
+namespace bstb::compiler::style {
+
+  template <template <typename> typename T, buffer::Buffer Buffer>
+  struct C {
+    using Impl = T<Buffer>; 
+    
+    Command<Buffer> cmd;
+
+    fs::path output_path {};
+    fs::path depfile_path {};
+    bool track_deps {};
+    bool deps_armed {};
+    Cache* object_cache {};
+    fs::Snapshot* stat_snapshot {};
+    std::vector<std::string> inputs {};
+    fs::path pch_header {};
+    fs::path pch_dir {};
+    bool pch_armed {};
+
+    constexpr C(std::string_view name) {
+      cmd.arg(name);
+    }
+
+    template <typename U>
+    constexpr auto arg(U&& arg) -> C& {
+      Impl::arg(cmd, std::forward<U>(arg));
+      return *this;
+    }
+
+    template <typename U>
+    constexpr auto input(U&& arg) -> C& {
+      inputs.push_back(fs::path(arg).string());
+      Impl::input(cmd, std::forward<U>(arg));
+      return *this;
+    }
+
+    template <typename U>
+    constexpr auto output(U&& arg) -> C& {
+      output_path = fs::path(arg);
+      Impl::output(cmd, std::forward<U>(arg));
+      return *this;
+    }
+
+    constexpr auto version(std::string_view str) -> C& {
+      Impl::version(cmd, str);
+      return *this;
+    }
+
+    constexpr auto warn(std::string_view str) -> C& {
+      Impl::warn(cmd, str);
+      return *this;
+    }
+
+    constexpr auto define(std::string_view str) -> C& {
+      Impl::define(cmd, str);
+      return *this;
+    }
+
+    template <typename U>
+    constexpr auto include_path(U&& str) -> C& {
+      Impl::include_path(cmd, std::forward<U>(str));
+      return *this;
+    }
+
+    template <typename U>
+    constexpr auto link_path(U&& str) -> C& {
+      Impl::link_path(cmd, str);
+      return *this;
+    }
+
+    template <typename U>
+    constexpr auto link(U&& str) -> C& {
+      Impl::link(cmd, str);
+      return *this;
+    }
+
+    constexpr auto opt(std::string_view str) -> C& {
+      Impl::opt(cmd, str);
+      return *this;
+    }
+
+    constexpr auto debug_info() -> C& {
+      Impl::debug_info(cmd);
+      return *this;
+    }
+
+    constexpr auto no_exe() -> C& {
+      Impl::no_exe(cmd);
+      return *this;
+    }
+
+    constexpr auto feature(std::string_view str) -> C& {
+      Impl::feature(cmd, str);
+      return *this;
+    }
+
+    constexpr auto arch(std::string_view str) -> C& {
+      Impl::arch(cmd, str);
+      return *this;
+    }
+    
+    // Skips compiles whose output is newer than everything in its depfile. The depfile
+    // is written by the compiler next to the output unless a path is given.
+    auto incremental(const fs::path& depfile = {}) -> C& {
+      track_deps = true;
+      depfile_path = depfile;
+      return *this;
+    }
+
+    auto up_to_date() -> bool {
+      if (!track_deps || output_path.empty()) {
+        return false;
+      }
+
+      if (!deps_armed) {
+        if (depfile_path.empty()) {
+          depfile_path = fs::path(output_path) += ".d";
+        }
+        Impl::depfile(cmd, depfile_path);
+        deps_armed = true;
+      }
+
+      if (fs::up_to_date(output_path, depfile_path, stat_snapshot)) {
+        return true;
+      }
+
+      // The output is about to be rewritten, so its cached stat is no longer valid.
+      if (stat_snapshot) {
+        stat_snapshot->invalidate(output_path);
+      }
+      return false;
+    }
+
+    // Serves the staleness checks of incremental compiles from a shared stat snapshot.
+    auto snapshot(fs::Snapshot& snapshot) -> C& {
+      stat_snapshot = &snapshot;
+      return *this;
+    }
+
+    // Serves objects from `cache` when the same preprocessed source was already compiled
+    // with the same arguments. The cache must outlive the compiles that use it.
+    auto cache(Cache& cache) -> C& {
+      object_cache = &cache;
+      return *this;
+    }
+
+    // Force includes `header` into every compile through a precompiled header, built into
+    // `dir` the first time it's needed. Each distinct set of flags gets its own PCH, so a
+    // compile never picks up one built with different defines or options. If building it
+    // fails the header is parsed as usual. Scheduler and Graph build it as a job of its own
+    // that the compiles wait for, a lone compile builds it before starting.
+    auto pch(const fs::path& header, const fs::path& dir = "pch") -> C& {
+      pch_header = fs::absolute(header).lexically_normal();
+      pch_dir = dir;
+      return *this;
+    }
+
+    struct Precompiled {
+      fs::path stub;
+      fs::path pch;
+      fs::path depfile;
+      fs::path lock;
+      Command<buffer::HeapBuffer> build;
+    };
+
+    // Works out where the PCH matching the current flags lives and the command that builds
+    // it. Must run before the PCH is armed, as arming adds to the flags.
+    auto plan_pch() -> Precompiled {
+      auto hasher = hash::Fnv{};
+      auto build = Command<buffer::HeapBuffer>{};
+      auto language = std::string_view{};
+
+      const auto* args = cmd.buffer.exec_args();
+      for (size_t i = 0; args[i]; ++i) {
+        const auto arg = std::string_view{ args[i] };
+        if ((arg == "-o" || arg == "-MF") && args[i + 1]) {
+          ++i;
+          continue;
+        }
+        if (arg == "-MMD" || arg == "-c" || std::find(inputs.begin(), inputs.end(), arg) != inputs.end()) {
+          continue;
+        }
+
+        // An explicit language applies to the header too, as its header flavour.
+        hasher.update(arg).update(std::string_view{ "\0", 1 });
+        if (arg == "-x" && args[i + 1]) {
+          language = args[++i];
+          hasher.update(language).update(std::string_view{ "\0", 1 });
+          continue;
+        }
+        if (arg.starts_with("-x")) {
+          language = arg.substr(2);
+          continue;
+        }
+        build.arg(arg);
+      }
+
+      // Otherwise C++ sources make a C++ header, failing that the driver goes by extension.
+      if (language.empty()) {
+        constexpr static std::string_view cpp_extensions[] = { ".cpp", ".cc", ".cxx", ".c++", ".cp", ".C", ".CPP" };
+        const auto is_cpp = std::any_of(inputs.begin(), inputs.end(), [](const auto& input) {
+          const auto extension = fs::path(input).extension().native();
+          return std::find(std::begin(cpp_extensions), std::end(cpp_extensions), extension) != std::end(cpp_extensions);
+        });
+        language = is_cpp ? "c++" : "";
+      }
+
+      // A PCH is only valid for the exact compiler that wrote it.
+      const auto compiler = std::string_view{ args[0] };
+      const auto binary = sys::io::stat_path(resolve_impl(args[0]));
+      hasher.update(pch_header.native());
+      hasher.update(language);
+      hasher.update(reinterpret_cast<unsigned char const*>(&binary.mtime), sizeof(binary.mtime));
+
+      auto ec = std::error_code{};
+      const auto dir = pch_dir / hash::hex(hasher.digest());
+      fs::create_directories(dir, ec);
+
+      auto plan = Precompiled{ dir / pch_header.filename(), {}, {}, dir / "lock", std::move(build) };
+      plan.pch = fs::path(plan.stub) += Impl::pch_extension(compiler);
+      plan.depfile = fs::path(plan.pch) += ".d";
+
+      using Build = T<buffer::HeapBuffer>;
+      Build::header(plan.build, language, plan.stub);
+      Build::output(plan.build, plan.pch);
+      Build::depfile(plan.build, plan.depfile);
+      return plan;
+    }
+
+    // Takes the lock on a PCH directory, other builds may be sharing it. The stub is
+    // written under the lock, so nobody sees it half written.
+    auto lock_pch(const Precompiled& plan) -> OwnedFd {
+      auto lock = OwnedFd(sys::io::open_fd_write(plan.lock.c_str()));
+      sys::io::lock_fd(lock.get());
+
+      auto ec = std::error_code{};
+      if (!fs::exists(plan.stub, ec)) {
+        auto out = std::ofstream(plan.stub, std::ios::out | std::ios::trunc);
+        out << "#include \"" << pch_header.generic_string() << "\"\n";
+      }
+      return lock;
+    }
+
+    // Builds or reuses the PCH matching the current flags and returns the header to force
+    // include. That header includes the real one, so it works with or without its PCH.
+    auto precompile() -> fs::path {
+      auto plan = this->plan_pch();
+      const auto lock = this->lock_pch(plan);
+
+      if (!fs::up_to_date(plan.pch, plan.depfile, stat_snapshot)) {
+        const auto [status, err] = plan.build.run({});
+        if (err || status != 0) {
+          auto ec = std::error_code{};
+          fs::remove(plan.pch, ec);
+        }
+        if (stat_snapshot) {
+          stat_snapshot->invalidate(plan.pch);
+        }
+      }
+
+      return plan.stub;
+    }
+
+    // Starts building the PCH in the background, or skips it when it is up to date. Its
+    // directory stays locked until the build is reaped. Scheduler and Graph run this as a
+    // job of its own that the compiles using the PCH wait for.
+    auto precompile_async(const Config& config = {}) -> Result<Future> {
+      auto plan = this->plan_pch();
+      auto lock = std::make_shared<OwnedFd>(this->lock_pch(plan));
+
+      if (fs::up_to_date(plan.pch, plan.depfile, stat_snapshot)) {
+        return { Future::Skipped() };
+      }
+      if (stat_snapshot) {
+        stat_snapshot->invalidate(plan.pch);
+      }
+
+      auto res = plan.build.run_async(config);
+      if (!res) {
+        res.ok.reaped = [lock, pch = plan.pch](sys::process::Status status) {
+          auto ec = std::error_code{};
+          if (status != 0) {
+            fs::remove(pch, ec);
+          }
+        };
+      }
+      return res;
+    }
+
+    // Force includes the PCH's stub, building the PCH first unless `built` says a job
+    // already takes care of that.
+    auto arm_pch(bool built = false) -> void {
+      if (pch_header.empty() || pch_armed) {
+        return;
+      }
+
+      pch_armed = true;
+      Impl::force_include(cmd, built ? this->plan_pch().stub : this->precompile());
+    }
+
+    auto compile(const Config& config) -> Result<Exit> {
+      this->arm_pch();
+      if (this->up_to_date()) {
+        return { 0 };
+      }
+
+      if (!object_cache || output_path.empty()) {
+        return cmd.run(config);
+      }
+
+      auto [key, err] = object_cache->key(cmd);
+      if (err) {
+        return cmd.run(config);
+      }
+
+      if (object_cache->fetch(key, output_path, depfile_path)) {
+        return { 0 };
+      }
+
+      // Compilers may rewrite their output in place, which must never touch a hard linked cache entry.
+      auto ec = std::error_code{};
+      fs::remove(output_path, ec);
+
+      auto res = cmd.run(config);
+      if (!res && res.ok == 0) {
+        object_cache->store(key, output_path, depfile_path);
+      }
+      return res;
+    }
+
+    auto compile_async(const Config& config) -> Result<Future> {
+      this->arm_pch();
+      if (this->up_to_date()) {
+        return { Future::Skipped() };
+      }
+
+      if (!object_cache || output_path.empty()) {
+        return cmd.run_async(config);
+      }
+
+      auto [key, err] = object_cache->key(cmd);
+      if (err) {
+        return cmd.run_async(config);
+      }
+
+      if (object_cache->fetch(key, output_path, depfile_path)) {
+        return { Future::Skipped() };
+      }
+
+      auto ec = std::error_code{};
+      fs::remove(output_path, ec);
+
+      auto res = cmd.run_async(config);
+      if (!res) {
+        object_cache->pending.push_back({ std::move(key), output_path, depfile_path, res.ok.pid });
+        res.ok.reaped = [cache = object_cache, pid = res.ok.pid](sys::process::Status status) {
+          cache->finished(pid, status);
+        };
+      }
+      return res;
+    }
+  };
+
+} // namespace bstb::compiler::impl
+
+namespace bstb::compiler::c {
+
+  template <buffer::Buffer Buffer>
+  using GCC = style::C<impl::GNU, Buffer>; 
+
+  template <buffer::Buffer Buffer = buffer::Default> 
+  [[nodiscard]]
+  constexpr auto gcc() -> GCC<Buffer> {
+    return { "gcc" };
+  }
+
+  template <buffer::Buffer Buffer>
+  using Clang = style::C<impl::GNU, Buffer>;
+
+  template <buffer::Buffer Buffer = buffer::Default>
+  [[nodiscard]]
+  constexpr auto clang() -> Clang<Buffer> {
+    return { "clang" };
+  }
+
+} // namespace bstb::compiler::c
+
+namespace bstb::compiler::cpp {
+
+  template <buffer::Buffer Buffer>
+  using GCC = style::C<impl::GNU, Buffer>; 
+
+  template <buffer::Buffer Buffer = buffer::Default>
+  [[nodiscard]]
+  constexpr auto gcc() -> GCC<Buffer> {
+    return { "g++" };
+  } 
+
+  template <buffer::Buffer Buffer>
+  using Clang = style::C<impl::GNU, Buffer>;
+
+  template <buffer::Buffer Buffer = buffer::Default>
+  [[nodiscard]]
+  constexpr auto clang() -> Clang<Buffer> {
+    return { "clang++" };
+  }
+
+} // namespace bstb::compiler::cpp
+
+namespace bstb::compiler {
+  
+
+  #if defined(__clang__)
+    template <buffer::Buffer Buffer = buffer::Default>
+    [[nodiscard]]
+    constexpr auto native() -> decltype(auto) { return cpp::clang<Buffer>(); }
+  #elif defined(__GNUC__) || defined(__GNUG__) || defined(__MINGW32__) || defined(__MINGW64__)
+    template <buffer::Buffer Buffer = buffer::Default>
+    [[nodiscard]]
+    constexpr auto native() -> decltype(auto) { return cpp::gcc<Buffer>(); }
+    
+  #endif
+
+} // namespace bstb::compiler
+
+namespace bstb {
+
+  // How long commands took last time and how much memory they peaked at, keyed on a hash
+  // of their argv. The log is a flat file of 24 byte records that are only ever appended
+  // to, the newest record for a key wins. Its first record is a header carrying the format
+  // version, logs written in any other format are discarded. Schedulers use it to start the longest work
+  // first and to keep memory hungry work from running all at once.
+  struct Durations {
+    struct Record {
+      uint64_t key;
+      uint64_t ns;
+      uint64_t rss_kb;
+    };
+
+    struct Cost {
+      uint64_t ns;
+      uint64_t rss_kb;
+    };
+
+    constexpr static char Magic[8] = { 'B', 'S', 'T', 'B', 'D', 'U', 'R', 'S' };
+    constexpr static uint64_t Version = 2;
+
+    static inline auto Header() -> Record {
+      auto header = Record{ 0, Version, sizeof(Record) };
+      std::memcpy(&header.key, Magic, sizeof(Magic));
+      return header;
+    }
+
+    fs::path path = ".bstb_durations";
+    std::unordered_map<uint64_t, Cost> known {};
+    std::vector<Record> pending {};
+    uint64_t total = 0;
+    uint64_t total_rss_kb = 0;
+
+    static inline auto Load(const fs::path& path = ".bstb_durations") -> Durations {
+      auto durations = Durations{ path };
+
+      auto [map, err] = MMap::Read(path.c_str());
+      if (err) {
+        return durations;
+      }
+
+      const auto count = map.size / sizeof(Record);
+      if (!count) {
+        return durations;
+      }
+
+      const auto header = Header();
+      if (map.size % sizeof(Record) || std::memcmp(map.data, &header, sizeof(Record)) != 0) {
+        durations.compact();
+        return durations;
+      }
+
+      for (size_t i = 1; i < count; ++i) {
+        auto record = Record{};
+        std::memcpy(&record, static_cast<unsigned char const*>(map.data) + i * sizeof(Record), sizeof(Record));
+        durations.known[record.key] = { record.ns, record.rss_kb };
+      }
+
+      for (const auto& [key, cost] : durations.known) {
+        durations.total += cost.ns;
+        durations.total_rss_kb += cost.rss_kb;
+      }
+
+      // Rewrite the log once most of it is superseded records.
+      if (count > 2 * durations.known.size() + 256) {
+        durations.compact();
+      }
+      return durations;
+    }
+
+    // Never 0, so 0 can stand for work without a key.
+    template <buffer::Buffer Buffer>
+    static auto key(Command<Buffer>& command) -> uint64_t {
+      auto hasher = hash::Fnv{};
+      const auto* args = command.buffer.exec_args();
+      for (size_t i = 0; args[i]; ++i) {
+        hasher.update(std::string_view{ args[i] }).update(std::string_view{ "\0", 1 });
+      }
+      return hasher.digest() | 1;
+    }
+
+    static auto key(std::string_view name) -> uint64_t {
+      return hash::Fnv{}.update(name).digest() | 1;
+    }
+
+    // Unknown work is assumed to take as long as the average known work.
+    auto estimate(uint64_t key) const -> uint64_t {
+      if (const auto it = known.find(key); it != known.end()) {
+        return it->second.ns;
+      }
+      return known.empty() ? 0 : total / known.size();
+    }
+
+    // Likewise for the peak resident set size, in KB.
+    auto peak(uint64_t key) const -> uint64_t {
+      if (const auto it = known.find(key); it != known.end()) {
+        return it->second.rss_kb;
+      }
+      return known.empty() ? 0 : total_rss_kb / known.size();
+    }
+
+    // Times are smoothed over runs, peaks keep the latest run so a grown job is noticed at once.
+    auto record(uint64_t key, uint64_t ns, uint64_t rss_kb = 0) -> void {
+      if (!key) {
+        return;
+      }
+
+      auto& slot = known[key];
+      total -= slot.ns;
+      total_rss_kb -= slot.rss_kb;
+      slot.ns = slot.ns ? (slot.ns * 3 + ns) / 4 : ns;
+      slot.rss_kb = rss_kb;
+      total += slot.ns;
+      total_rss_kb += slot.rss_kb;
+      pending.push_back({ key, slot.ns, slot.rss_kb });
+    }
+
+    // Appends everything recorded since the last flush. Each record is written whole, so
+    // concurrent builds appending to the same log don't tear each other's records.
+    auto flush() -> void {
+      if (pending.empty()) {
+        return;
+      }
+
+      const auto fd = OwnedFd(sys::io::open_fd_append(path.c_str()));
+      if (fd.valid()) {
+        sys::io::lock_fd(fd.get());
+        if (!sys::io::get_fd_size(fd.get())) {
+          const auto header = Header();
+          sys::io::write_fd(fd.get(), &header, sizeof(header));
+        }
+        sys::io::write_fd(fd.get(), pending.data(), pending.size() * sizeof(Record));
+        sys::io::unlock_fd(fd.get());
+      }
+      pending.clear();
+    }
+
+    auto compact() -> void {
+      const auto fd = OwnedFd(sys::io::open_fd_write(path.c_str()));
+      if (!fd.valid()) {
+        return;
+      }
+
+      auto records = std::vector<Record>{ Header() };
+      records.reserve(known.size() + 1);
+      for (const auto& [key, cost] : known) {
+        records.push_back({ key, cost.ns, cost.rss_kb });
+      }
+
+      sys::io::lock_fd(fd.get());
+      sys::io::fd_truncate(fd.get(), 0);
+      sys::io::write_fd(fd.get(), records.data(), records.size() * sizeof(Record));
+      sys::io::unlock_fd(fd.get());
+    }
+
+    Durations() = default;
+    Durations(fs::path _path) : path(std::move(_path)) {}
+    Durations(Durations&&) = default;
+    auto operator=(Durations&&) -> Durations& = default;
+
+    ~Durations() {
+      this->flush();
+    }
+  };
+
+  // GNU make compatible jobserver. Every process owns one implicit token, any extra
+  // process it spawns must first take a token from the shared pool and give it back
+  // once the process has exited.
+  struct Jobserver {
+    OwnedFd read {};
+    OwnedFd write {};
+    std::vector<char> tokens {};
+
+    // Joins the jobserver advertised in MAKEFLAGS by a parent make, ninja or bootstrab.
+    static inline auto Inherited() -> Result<Jobserver> {
+      const auto* flags = sys::env::get("MAKEFLAGS");
+      if (!flags) {
+        return { .err = { "No jobserver in MAKEFLAGS." } };
+      }
+
+      auto auth = std::string_view{};
+      for (const auto prefix : { "--jobserver-auth=", "--jobserver-fds=" }) {
+        if (const auto* at = std::strstr(flags, prefix)) {
+          auth = at + std::strlen(prefix);
+          auth = auth.substr(0, auth.find(' '));
+        }
+      }
+
+      if (auth.empty()) {
+        return { .err = { "No jobserver in MAKEFLAGS." } };
+      }
+
+      auto server = Jobserver{};
+      if (auth.starts_with("fifo:")) {
+        const auto path = std::string{ auth.substr(5) };
+        server.read.reset(sys::io::open_fd_nonblock(path.c_str(), O_RDONLY));
+        server.write.reset(sys::io::open_fd_nonblock(path.c_str(), O_WRONLY));
+      } else {
+        const auto comma = auth.find(',');
+        if (comma == std::string_view::npos) {
+          return { .err = { "Malformed jobserver auth." } };
+        }
+
+        // Reopening through /proc gives us a private non-blocking file description,
+        // so the inherited pipe stays blocking for everybody else.
+        const auto fd_path = [](std::string_view fd) {
+          return std::string{"/proc/self/fd/"} += fd;
+        };
+        server.read.reset(sys::io::open_fd_nonblock(fd_path(auth.substr(0, comma)).c_str(), O_RDONLY));
+        server.write.reset(sys::io::open_fd_nonblock(fd_path(auth.substr(comma + 1)).c_str(), O_WRONLY));
+      }
+
+      if (!server.read.valid() || !server.write.valid()) {
+        return { .err = { "Failed to open inherited jobserver." } };
+      }
+
+      return { std::move(server) };
+    }
+
+    // Creates a pool of `jobs` tokens and exports it through MAKEFLAGS so that every
+    // process spawned afterwards shares the same limit.
+    static inline auto Create(size_t jobs) -> Result<Jobserver> {
+      sys::io::Fd fds[2];
+      if (sys::io::make_pipe(fds) == sys::io::FAILED) {
+        return { .err = { "Failed to create jobserver pipe." } };
+      }
+
+      auto server = Jobserver{};
+      auto pool_read = OwnedFd(fds[0]);
+      auto pool_write = OwnedFd(fds[1]);
+
+      for (size_t i = 1; i < jobs; ++i) {
+        sys::io::write_fd(pool_write.get(), "+", 1);
+      }
+
+      const auto fd_path = [](sys::io::Fd fd) {
+        return std::string{"/proc/self/fd/"} += std::to_string(fd);
+      };
+      server.read.reset(sys::io::open_fd_nonblock(fd_path(fds[0]).c_str(), O_RDONLY));
+      server.write.reset(sys::io::open_fd_nonblock(fd_path(fds[1]).c_str(), O_WRONLY));
+
+      if (!server.read.valid() || !server.write.valid()) {
+        return { .err = { "Failed to open jobserver pipe." } };
+      }
+
+      const auto flags = (
+        "-j" + std::to_string(jobs) +
+        " --jobserver-auth=" + std::to_string(fds[0]) + ',' + std::to_string(fds[1]) +
+        " --jobserver-fds=" + std::to_string(fds[0]) + ',' + std::to_string(fds[1])
+      );
+      sys::env::set("MAKEFLAGS", flags.c_str());
+
+      // The pipe itself must stay open for the lifetime of the build so children can inherit it.
+      pool_read.release();
+      pool_write.release();
+
+      return { std::move(server) };
+    }
+
+    // Joins an inherited jobserver if there is one, otherwise becomes the server.
+    static inline auto Open(size_t jobs = sys::process::cpu_count()) -> Result<Jobserver> {
+      if (auto inherited = Inherited(); !inherited) {
+        return inherited;
+      }
+      return Create(jobs);
+    }
+
+    inline auto try_acquire() -> bool {
+      char token;
+      if (sys::io::read_fd(read.get(), &token, 1) != 1) {
+        return false;
+      }
+      tokens.push_back(token);
+      return true;
+    }
+
+    inline auto release() -> void {
+      if (tokens.empty()) {
+        return;
+      }
+      sys::io::write_fd(write.get(), &tokens.back(), 1);
+      tokens.pop_back();
+    }
+
+    inline auto held() const -> size_t {
+      return tokens.size();
+    }
+
+    ~Jobserver() {
+      while (!tokens.empty()) {
+        this->release();
+      }
+    }
+
+    Jobserver() = default;
+    Jobserver(Jobserver&&) = default;
+    auto operator=(Jobserver&&) -> Jobserver& = default;
+  };
+
+  // Keeps at most `jobs` processes in flight, launching queued work as soon as a slot frees up.
+  // With `durations`, the jobs that took longest last time are launched first, so the build
+  // doesn't end on one long job running alone. With a `memory_budget_kb`, a job is only
+  // admitted while the expected peak memory of everything running stays within budget,
+  // jobs that don't fit yet are passed over for smaller ones behind them.
+  struct Scheduler {
+    using Launch = std::function<Result<Future>()>;
+
+    struct Job {
+      size_t id;
+      uint64_t key;
+      Launch launch;
+      uint64_t rss_kb {};
+      size_t after = SIZE_MAX;
+    };
+
+    size_t jobs = sys::process::cpu_count();
+    Jobserver* jobserver = nullptr;
+    Durations* durations = nullptr;
+    uint64_t memory_budget_kb = 0;
+    std::deque<Job> queue {};
+    std::unordered_map<std::string, size_t> pchs {};
+    size_t pushed = 0;
+
+    // The memory this process is allowed to use, a good default for `memory_budget_kb`.
+    static inline auto MemoryLimit() -> uint64_t {
+      return sys::process::memory_limit() / 1024;
+    }
+
+    auto push(Launch launch, uint64_t key = 0) -> size_t {
+      queue.push_back({ pushed, key, std::move(launch) });
+      return pushed++;
+    }
+
+    // Expected peak memory of a queued job, used over whatever `durations` remembers.
+    auto hint(size_t id, uint64_t rss_kb) -> Scheduler& {
+      for (auto& job : queue) {
+        if (job.id == id) {
+          job.rss_kb = rss_kb;
+        }
+      }
+      return *this;
+    }
+
+    auto cost(const Job& job) const -> uint64_t {
+      if (job.rss_kb) {
+        return job.rss_kb;
+      }
+      return durations ? durations->peak(job.key) : 0;
+    }
+
+    // The first queued job whose predecessor is done and that fits next to `committed`,
+    // anything fits when nothing runs.
+    auto admit(uint64_t committed, bool idle, const std::vector<bool>& done) -> std::deque<Job>::iterator {
+      return std::find_if(queue.begin(), queue.end(), [&](const auto& job) {
+        if (job.after != SIZE_MAX && !done[job.after]) {
+          return false;
+        }
+        return !memory_budget_kb || idle || committed + this->cost(job) <= memory_budget_kb;
+      });
+    }
+
+    template <buffer::Buffer Buffer>
+    auto push(Command<Buffer> command, const Config& config = {}) -> size_t {
+      const auto key = Durations::key(command);
+      return this->push([command = std::move(command), config] () mutable {
+        return command.run_async(config);
+      }, key);
+    }
+
+    // A compile with a PCH waits for a job building it, shared by every compile queued with
+    // the same flags. If that job fails the compiles still run, parsing the header instead.
+    template <template <typename> typename T, buffer::Buffer Buffer>
+    auto push(compiler::style::C<T, Buffer> compiler, const Config& config = {}) -> size_t {
+      const auto key = Durations::key(compiler.cmd);
+
+      auto after = SIZE_MAX;
+      if (!compiler.pch_header.empty() && !compiler.pch_armed) {
+        const auto stub = compiler.plan_pch().stub.string();
+        auto [it, inserted] = pchs.try_emplace(stub, pushed);
+        if (inserted) {
+          this->push([pch = compiler, config] () mutable {
+            return pch.precompile_async(config);
+          }, Durations::key(stub));
+        }
+        after = it->second;
+        compiler.arm_pch(true);
+      }
+
+      const auto id = this->push([compiler = std::move(compiler), config] () mutable {
+        return compiler.compile_async(config);
+      }, key);
+      queue.back().after = after;
+      return id;
+    }
+
+    // Runs everything queued so far. Results are indexed by the id returned from push().
+    auto run() -> std::vector<Result<Exit>> {
+      auto results = std::vector<Result<Exit>>(pushed);
+      auto done = std::vector<bool>(pushed);
+      auto running = TaskList{};
+      struct Running {
+        sys::process::Pid pid;
+        size_t id;
+        uint64_t key;
+        std::chrono::steady_clock::time_point start;
+        uint64_t expected;
+      };
+
+      auto ids = std::vector<Running>{};
+      const auto slots = std::max<size_t>(jobs, 1);
+      uint64_t committed = 0;
+
+      if (durations) {
+        std::stable_sort(queue.begin(), queue.end(), [this](const auto& lhs, const auto& rhs) {
+          return durations->estimate(lhs.key) > durations->estimate(rhs.key);
+        });
+      }
+
+      while (!queue.empty() || !running.empty()) {
+        auto starved = false;
+        while (running.size() < slots && !queue.empty()) {
+          const auto next = this->admit(committed, running.empty(), done);
+          if (next == queue.end()) {
+            break;
+          }
+
+          if (jobserver && !running.empty() && !jobserver->try_acquire()) {
+            starved = true;
+            break;
+          }
+
+          const auto expected = this->cost(*next);
+          auto [id, key, launch, rss_kb, after] = std::move(*next);
+          queue.erase(next);
+
+          auto [future, err] = launch();
+          if (err || future.skipped()) {
+            results[id] = err ? Result<Exit>{ .err = err } : Result<Exit>{ 0 };
+            done[id] = true;
+            if (jobserver && !running.empty()) {
+              jobserver->release();
+            }
+            continue;
+          }
+
+          ids.push_back({ future.pid, id, key, std::chrono::steady_clock::now(), expected });
+          running.push(std::move(future));
+          committed += expected;
+        }
+
+        if (running.empty()) {
+          break;
+        }
+
+        // Wake up on whichever comes first, a free token or an exiting child.
+        if (starved && running.arm()) {
+          const sys::io::Fd fds[] = { jobserver->read.get(), running.poller.get() };
+          sys::io::wait_readable(fds, 2, -1);
+          if (sys::io::wait_readable(&fds[1], 1, 0) <= 0) {
+            continue;
+          }
+        }
+
+        auto [finished, err] = running.wait_any();
+        if (err) {
+          for (const auto& job : ids) {
+            results[job.id] = { .err = err };
+          }
+          for (const auto& job : queue) {
+            results[job.id] = { .err = { "Job was not run, the scheduler failed." } };
+          }
+          queue.clear();
+          running.cancel();
+          while (jobserver && jobserver->held()) {
+            jobserver->release();
+          }
+          break;
+        }
+
+        const auto it = std::find_if(ids.begin(), ids.end(), [&](const auto& entry) {
+          return entry.pid == finished.future.pid;
+        });
+        const auto& [pid, id, key, start, expected] = *it;
+        committed -= expected;
+        done[id] = true;
+        if (finished.status == sys::process::FAILED) {
+          results[id] = { .err = { "Process did not complete." } };
+        } else {
+          results[id] = {{ finished.status, finished.usage }};
+        }
+
+        if (durations && finished.status == 0) {
+          durations->record(key, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), finished.usage.max_rss_kb);
+        }
+        ids.erase(it);
+
+        while (jobserver && jobserver->held() > (running.empty() ? 0 : running.size() - 1)) {
+          jobserver->release();
+        }
+      }
+
+      if (durations) {
+        durations->flush();
+      }
+
+      pushed = 0;
+      pchs.clear();
+      return results;
+    }
+  };
+
+  // Targets with dependencies, run as soon as everything they depend on has finished.
+  // Targets are processes (commands, compilers) or in-process actions such as embedder
+  // steps, which run on their own thread. A target that fails takes everything that
+  // depends on it down with it, unrelated targets keep going. With `durations`, ready
+  // targets on the longest remaining path through the graph are started first, and a
+  // `memory_budget_kb` holds back ready targets as it does for the Scheduler.
+  struct Graph {
+    using Node = size_t;
+    using Launch = Scheduler::Launch;
+    using Action = std::function<bool()>;
+
+    enum class State {
+      Pending,
+      Done,
+      UpToDate,
+      Failed,
+      Skipped,
+    };
+
+    struct Target {
+      std::string name;
+      Launch launch {};
+      Action action {};
+      std::vector<fs::path> inputs {};
+      std::vector<fs::path> outputs {};
+      std::vector<Node> deps {};
+      uint64_t key {};
+      // Dependents of an optional target still run when it fails.
+      bool optional {};
+    };
+
+    size_t jobs = sys::process::cpu_count();
+    Jobserver* jobserver = nullptr;
+    Durations* durations = nullptr;
+    uint64_t memory_budget_kb = 0;
+    std::vector<Target> targets {};
+    std::unordered_map<std::string, Node> pchs {};
+
+    // Targets without an argv are timed under their name.
+    auto add(std::string name, Launch launch) -> Node {
+      const auto key = Durations::key(name);
+      targets.push_back({ std::move(name), std::move(launch) });
+      targets.back().key = key;
+      return targets.size() - 1;
+    }
+
+    auto add(std::string name, Action action) -> Node {
+      const auto key = Durations::key(name);
+      targets.push_back({ std::move(name), {}, std::move(action) });
+      targets.back().key = key;
+      return targets.size() - 1;
+    }
+
+    template <buffer::Buffer Buffer>
+    auto add(std::string name, Command<Buffer> command, const Config& config = {}) -> Node {
+      const auto key = Durations::key(command);
+      const auto node = this->add(std::move(name), Launch{ [command = std::move(command), config] () mutable {
+        return command.run_async(config);
+      } });
+      targets[node].key = key;
+      return node;
+    }
+
+    // A compile with a PCH depends on an optional target building it, shared by every
+    // compile added with the same flags.
+    template <template <typename> typename T, buffer::Buffer Buffer>
+    auto add(std::string name, compiler::style::C<T, Buffer> compiler, const Config& config = {}) -> Node {
+      const auto key = Durations::key(compiler.cmd);
+
+      auto pch = targets.size();
+      if (!compiler.pch_header.empty() && !compiler.pch_armed) {
+        const auto stub = compiler.plan_pch().stub.string();
+        auto [it, inserted] = pchs.try_emplace(stub, pch);
+        if (inserted) {
+          this->add(stub, Launch{ [pch = compiler, config] () mutable {
+            return pch.precompile_async(config);
+          } });
+          targets.back().optional = true;
+        }
+        pch = it->second;
+        compiler.arm_pch(true);
+      }
+
+      const auto node = this->add(std::move(name), Launch{ [compiler = std::move(compiler), config] () mutable {
+        return compiler.compile_async(config);
+      } });
+      targets[node].key = key;
+      if (pch != node) {
+        this->depends(node, pch);
+      }
+      return node;
+    }
+
+    auto depends(Node node, Node dep) -> Graph& {
+      targets[node].deps.push_back(dep);
+      return *this;
+    }
+
+    // A target that reads another target's output depends on it without saying so. When
+    // every output is newer than every input the target is up to date and doesn't run.
+    auto input(Node node, const fs::path& path) -> Graph& {
+      targets[node].inputs.push_back(path);
+      return *this;
+    }
+
+    auto output(Node node, const fs::path& path) -> Graph& {
+      targets[node].outputs.push_back(path);
+      return *this;
+    }
+
+    auto up_to_date(Node node) const -> bool {
+      const auto& inputs = targets[node].inputs;
+      const auto& outputs = targets[node].outputs;
+      if (inputs.empty() || outputs.empty()) {
+        return false;
+      }
+
+      for (const auto& output : outputs) {
+        const auto built = sys::io::stat_path(output.c_str());
+        if (!built.exists) {
+          return false;
+        }
+        for (const auto& input : inputs) {
+          if (sys::io::stat_path(input.c_str()).mtime > built.mtime) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    // Every edge, declared or implied by inputs and outputs, as a list of dependents per target.
+    auto dependents() const -> std::vector<std::vector<Node>> {
+      auto producers = std::unordered_map<std::string, Node>{};
+      for (Node node = 0; node < targets.size(); ++node) {
+        for (const auto& output : targets[node].outputs) {
+          producers.emplace(output.lexically_normal().string(), node);
+        }
+      }
+
+      auto edges = std::vector<std::vector<Node>>(targets.size());
+      for (Node node = 0; node < targets.size(); ++node) {
+        for (const auto dep : targets[node].deps) {
+          edges[dep].push_back(node);
+        }
+        for (const auto& input : targets[node].inputs) {
+          const auto it = producers.find(input.lexically_normal().string());
+          if (it != producers.end() && it->second != node) {
+            edges[it->second].push_back(node);
+          }
+        }
+      }
+
+      for (auto& edge : edges) {
+        std::sort(edge.begin(), edge.end());
+        edge.erase(std::unique(edge.begin(), edge.end()), edge.end());
+      }
+      return edges;
+    }
+
+    // Targets in dependency order. Targets on or behind a cycle are left out.
+    auto order(const std::vector<std::vector<Node>>& edges) const -> std::vector<Node> {
+      auto pending = std::vector<size_t>(targets.size());
+      for (const auto& edge : edges) {
+        for (const auto node : edge) {
+          ++pending[node];
+        }
+      }
+
+      auto sorted = std::vector<Node>{};
+      for (Node node = 0; node < targets.size(); ++node) {
+        if (!pending[node]) {
+          sorted.push_back(node);
+        }
+      }
+
+      for (size_t idx = 0; idx < sorted.size(); ++idx) {
+        for (const auto next : edges[sorted[idx]]) {
+          if (!--pending[next]) {
+            sorted.push_back(next);
+          }
+        }
+      }
+      return sorted;
+    }
+
+    // Targets on or behind a cycle, empty when the graph is acyclic.
+    auto cycle() const -> std::vector<Node> {
+      const auto sorted = this->order(this->dependents());
+      auto seen = std::vector<bool>(targets.size());
+      for (const auto node : sorted) {
+        seen[node] = true;
+      }
+
+      auto stuck = std::vector<Node>{};
+      for (Node node = 0; node < targets.size(); ++node) {
+        if (!seen[node]) {
+          stuck.push_back(node);
+        }
+      }
+      return stuck;
+    }
+
+    // The expected time from starting a target to the end of the longest chain of targets
+    // waiting on it.
+    auto weights(const std::vector<std::vector<Node>>& edges, const std::vector<Node>& sorted) const -> std::vector<uint64_t> {
+      auto weight = std::vector<uint64_t>(targets.size());
+      for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+        uint64_t longest = 0;
+        for (const auto next : edges[*it]) {
+          longest = std::max(longest, weight[next]);
+        }
+        weight[*it] = durations->estimate(targets[*it].key) + longest;
+      }
+      return weight;
+    }
+
+    auto cost(Node node) const -> uint64_t {
+      return durations ? durations->peak(targets[node].key) : 0;
+    }
+
+    // Runs every target at most `jobs` at a time, launching each one the moment its
+    // last dependency finishes. Results are indexed by the node returned from add().
+    auto run() -> Result<std::vector<State>> {
+      const auto edges = this->dependents();
+      const auto sorted = this->order(edges);
+      if (sorted.size() != targets.size()) {
+        return { .err = { "Targets have a dependency cycle." } };
+      }
+
+      const auto weight = durations ? this->weights(edges, sorted) : std::vector<uint64_t>{};
+      auto started = std::vector<std::chrono::steady_clock::time_point>(targets.size());
+      const auto elapsed = [&started](Node node) -> uint64_t {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started[node]).count();
+      };
+      auto states = std::vector<State>(targets.size(), State::Pending);
+      auto pending = std::vector<size_t>(targets.size());
+      for (const auto& edge : edges) {
+        for (const auto node : edge) {
+          ++pending[node];
+        }
+      }
+
+      auto ready = std::deque<Node>{};
+      for (Node node = 0; node < targets.size(); ++node) {
+        if (!pending[node]) {
+          ready.push_back(node);
+        }
+      }
+
+      // Actions report back through a pipe, so one poll covers them and child processes.
+      sys::io::Fd fds[2];
+      if (sys::io::make_capture_pipe(fds) == sys::io::FAILED) {
+        return { .err = { "Failed to create pipe." } };
+      }
+      const auto done_read = OwnedFd(fds[0]);
+      const auto done_write = OwnedFd(fds[1]);
+
+      struct Report {
+        Node node;
+        bool ok;
+      };
+
+      auto running = TaskList{};
+      auto pids = std::vector<std::pair<sys::process::Pid, Node>>{};
+      auto threads = std::vector<std::thread>{};
+      auto expected = std::vector<uint64_t>(targets.size());
+      size_t active = 0;
+      uint64_t committed = 0;
+      const auto slots = std::max<size_t>(jobs, 1);
+
+      const auto finish = [&](Node node, State state) {
+        states[node] = state;
+        if (state != State::Failed || targets[node].optional) {
+          for (const auto next : edges[node]) {
+            if (!--pending[next] && states[next] == State::Pending) {
+              ready.push_back(next);
+            }
+          }
+          return;
+        }
+
+        auto failed = std::vector<Node>{ node };
+        while (!failed.empty()) {
+          const auto current = failed.back();
+          failed.pop_back();
+          for (const auto next : edges[current]) {
+            if (states[next] == State::Pending) {
+              states[next] = State::Skipped;
+              failed.push_back(next);
+            }
+          }
+        }
+      };
+
+      for (;;) {
+        auto starved = false;
+        while (active < slots && !ready.empty()) {
+          // The heaviest ready target that fits next to `committed`, anything fits when nothing runs.
+          auto next = ready.end();
+          for (auto it = ready.begin(); it != ready.end(); ++it) {
+            if (memory_budget_kb && active && committed + this->cost(*it) > memory_budget_kb) {
+              continue;
+            }
+            if (next == ready.end() || (durations && weight[*next] < weight[*it])) {
+              next = it;
+            }
+          }
+          if (next == ready.end()) {
+            break;
+          }
+
+          if (jobserver && active && !jobserver->try_acquire()) {
+            starved = true;
+            break;
+          }
+
+          const auto node = *next;
+          ready.erase(next);
+
+          if (this->up_to_date(node)) {
+            finish(node, State::UpToDate);
+            if (jobserver && active) {
+              jobserver->release();
+            }
+            continue;
+          }
+
+          auto& target = targets[node];
+          started[node] = std::chrono::steady_clock::now();
+          if (target.action) {
+            ++active;
+            expected[node] = this->cost(node);
+            committed += expected[node];
+            threads.emplace_back([&target, node, fd = done_write.get()] {
+              const auto report = Report{ node, target.action() };
+              sys::io::write_fd(fd, &report, sizeof(report));
+            });
+            continue;
+          }
+
+          auto [future, err] = target.launch ? target.launch() : Result<Future>{ Future::Skipped() };
+          if (err || future.skipped()) {
+            finish(node, err ? State::Failed : State::Done);
+            if (jobserver && active) {
+              jobserver->release();
+            }
+            continue;
+          }
+
+          ++active;
+          expected[node] = this->cost(node);
+          committed += expected[node];
+          pids.emplace_back(future.pid, node);
+          running.push(std::move(future));
+        }
+
+        if (!active) {
+          break;
+        }
+
+        const auto armed = !running.empty() && running.arm();
+        sys::io::Fd wait_fds[3] = { done_read.get() };
+        size_t count = 1;
+        if (armed) {
+          wait_fds[count++] = running.poller.get();
+        }
+        if (starved) {
+          wait_fds[count++] = jobserver->read.get();
+        }
+        sys::io::wait_readable(wait_fds, count, armed || running.empty() ? -1 : 1);
+
+        for (auto report = Report{}; sys::io::read_fd(done_read.get(), &report, sizeof(report)) == sizeof(report);) {
+          --active;
+          committed -= expected[report.node];
+          if (durations && report.ok) {
+            durations->record(targets[report.node].key, elapsed(report.node));
+          }
+          finish(report.node, report.ok ? State::Done : State::Failed);
+        }
+
+        auto exited = false;
+        if (armed) {
+          exited = sys::io::wait_readable(&wait_fds[1], 1, 0) > 0;
+        } else {
+          exited = std::any_of(running.tasks.begin(), running.tasks.end(), [](const auto& task) {
+            return task.completed();
+          });
+        }
+
+        if (exited) {
+          auto [finished, err] = running.wait_any();
+          if (err) {
+            for (const auto& [pid, node] : pids) {
+              finish(node, State::Failed);
+            }
+            break;
+          }
+
+          const auto it = std::find_if(pids.begin(), pids.end(), [&](const auto& entry) {
+            return entry.first == finished.future.pid;
+          });
+          --active;
+          committed -= expected[it->second];
+          if (durations && finished.status == 0) {
+            durations->record(targets[it->second].key, elapsed(it->second), finished.usage.max_rss_kb);
+          }
+          finish(it->second, finished.status == 0 ? State::Done : State::Failed);
+          pids.erase(it);
+        }
+
+        while (jobserver && jobserver->held() > (active ? active - 1 : 0)) {
+          jobserver->release();
+        }
+      }
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+
+      if (durations) {
+        durations->flush();
+      }
+
+      return { std::move(states) };
+    }
+  };
+
+} // namespace bstb
+
+namespace bstb::compiler {
+
+  // Jumbo builds. Sources are split into batches that are compiled as one translation
+  // unit each, through generated files that #include every source of their batch.
+  struct Unity {
+    struct Batch {
+      fs::path source;
+      fs::path object;
+      std::vector<fs::path> inputs;
+    };
+
+    fs::path dir = "unity";
+    size_t batches = sys::process::cpu_count();
+    uintmax_t batch_bytes = 0;
+    bool isolate_changed = true;
+    size_t isolate_limit = 4;
+    std::vector<fs::path> sources {};
+    std::unordered_set<fs::path, fs::Hash> pinned {};
+    std::unordered_set<fs::path, fs::Hash> isolated {};
+
+    // Takes any range of paths or directory entries, e.g. from fs::filter.
+    template <typename Range>
+    auto add(Range&& range) -> Unity& {
+      for (const auto& source : range) {
+        sources.push_back(fs::absolute(fs::path(source)).lexically_normal());
+      }
+      return *this;
+    }
+
+    // Compiles `source` in its own translation unit, e.g. when it doesn't survive being
+    // batched with others.
+    auto isolate(const fs::path& source) -> Unity& {
+      pinned.insert(fs::absolute(source).lexically_normal());
+      return *this;
+    }
+
+    // Forgets every source isolated because it changed, the next plan batches them again.
+    auto reset() -> Unity& {
+      isolated.clear();
+      auto ec = std::error_code{};
+      fs::remove(dir / "isolated", ec);
+      return *this;
+    }
+
+    // Groups the sources into `batches` batches of about the same size in bytes, or into
+    // batches of at most `batch_bytes` when set. Batches are cut from the sorted source
+    // list as a whole, so isolating a file only ever changes the batch it came from.
+    //
+    // With `isolate_changed`, a source that is newer than the object of its batch is moved
+    // into its own translation unit. Its batch is rebuilt once without it, and later edits
+    // only recompile that one file. Isolated files are remembered in `dir` across runs and
+    // rejoin their batch the next time it is rebuilt anyway, unless they changed again.
+    // A batch with more than `isolate_limit` changed sources, e.g. after a checkout, is
+    // rebuilt whole instead.
+    auto plan() -> std::vector<Batch> {
+      auto ec = std::error_code{};
+      fs::create_directories(dir, ec);
+
+      std::sort(sources.begin(), sources.end());
+      sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+      this->load_isolated();
+
+      auto sizes = std::vector<uintmax_t>{};
+      uintmax_t total = 0;
+      for (const auto& source : sources) {
+        sizes.push_back(sys::io::stat_path(source.c_str()).size);
+        total += sizes.back();
+      }
+
+      auto groups = std::vector<std::vector<size_t>>{};
+      uintmax_t seen = 0;
+      uintmax_t filled = 0;
+      size_t last = SIZE_MAX;
+
+      for (size_t idx = 0; idx < sources.size(); ++idx) {
+        auto group = size_t{};
+        if (batch_bytes) {
+          if (groups.empty() || (filled && filled + sizes[idx] > batch_bytes)) {
+            filled = 0;
+            group = groups.size();
+          } else {
+            group = groups.size() - 1;
+          }
+          filled += sizes[idx];
+        } else {
+          const auto count = std::max<size_t>(batches, 1);
+          group = total ? static_cast<size_t>(seen * count / total) : idx * count / sources.size();
+        }
+        seen += sizes[idx];
+
+        if (group != last) {
+          groups.emplace_back();
+          last = group;
+        }
+        groups.back().push_back(idx);
+      }
+
+      auto planned = std::vector<Batch>{};
+      for (size_t group = 0; group < groups.size(); ++group) {
+        const auto name = "unity_" + std::to_string(group);
+        auto batch = Batch{ dir / (name + sources[groups[group].front()].extension().string()), dir / (name + ".o"), {} };
+
+        const auto built = sys::io::stat_path(batch.object.c_str());
+        const auto changed = [&built](const fs::path& source) {
+          return built.exists && sys::io::stat_path(source.c_str()).mtime > built.mtime;
+        };
+
+        // Isolated sources only move while the batch is being rebuilt, so that costs nothing extra.
+        if (!fs::up_to_date(batch.object, fs::path(batch.object) += ".d")) {
+          auto edited = std::vector<fs::path>{};
+          for (const auto idx : groups[group]) {
+            if (!this->is_pinned(sources[idx]) && changed(sources[idx])) {
+              edited.push_back(sources[idx]);
+            }
+          }
+
+          // Batches are contiguous runs of the sorted sources.
+          const auto& first = sources[groups[group].front()];
+          const auto& last = sources[groups[group].back()];
+          std::erase_if(isolated, [&](const auto& source) {
+            return !(source < first) && !(last < source);
+          });
+
+          if (isolate_changed && edited.size() <= isolate_limit) {
+            isolated.insert(edited.begin(), edited.end());
+          }
+        }
+
+        for (const auto idx : groups[group]) {
+          if (!this->is_isolated(sources[idx])) {
+            batch.inputs.push_back(sources[idx]);
+          }
+        }
+
+        if (batch.inputs.empty()) {
+          continue;
+        }
+
+        // Without its aggregate the batch falls back to one translation unit per source.
+        if (!this->write(batch)) {
+          isolated.insert(batch.inputs.begin(), batch.inputs.end());
+          continue;
+        }
+        planned.push_back(std::move(batch));
+      }
+
+      for (const auto& source : sources) {
+        if (this->is_isolated(source)) {
+          const auto object = source.stem().string() + "_" + hash::hex(hash::Fnv{}.update(source.native()).digest()) + ".o";
+          planned.push_back({ source, dir / object, { source } });
+        }
+      }
+
+      this->store_isolated();
+      return planned;
+    }
+
+    // Queues one compile per batch on `scheduler`, each a copy of `base` with the batch
+    // as its only input. Compiles are incremental, untouched batches are skipped.
+    template <template <typename> typename T, buffer::Buffer Buffer>
+    auto compile(const style::C<T, Buffer>& base, Scheduler& scheduler, const Config& config = {}) -> std::vector<fs::path> {
+      auto objects = std::vector<fs::path>{};
+      for (const auto& batch : this->plan()) {
+        auto compiler = base;
+        compiler.incremental().no_exe().input(batch.source.c_str()).output(batch.object.c_str());
+        scheduler.push(std::move(compiler), config);
+        objects.push_back(batch.object);
+      }
+      return objects;
+    }
+
+    template <template <typename> typename T, buffer::Buffer Buffer>
+    auto compile(const style::C<T, Buffer>& base, const Config& config = {}) -> Result<std::vector<fs::path>> {
+      auto scheduler = Scheduler{ .jobs = batches };
+      auto objects = this->compile(base, scheduler, config);
+
+      for (const auto& [status, err] : scheduler.run()) {
+        if (err) {
+          return { .err = err };
+        }
+        if (status != 0) {
+          return { .err = { "Unity batch failed to compile." } };
+        }
+      }
+
+      return { std::move(objects) };
+    }
+
+    auto is_pinned(const fs::path& source) const -> bool {
+      return pinned.contains(source);
+    }
+
+    auto is_isolated(const fs::path& source) const -> bool {
+      return this->is_pinned(source) || isolated.contains(source);
+    }
+
+    auto load_isolated() -> void {
+      auto in = std::ifstream(dir / "isolated");
+      for (auto line = std::string{}; std::getline(in, line);) {
+        if (!line.empty() && !this->is_pinned(line)) {
+          isolated.emplace(line);
+        }
+      }
+    }
+
+    // In source order, so the file only changes when the set does.
+    auto store_isolated() const -> void {
+      auto out = std::ofstream(dir / "isolated", std::ios::out | std::ios::trunc);
+      for (const auto& source : sources) {
+        if (isolated.contains(source)) {
+          out << source.native() << '\n';
+        }
+      }
+    }
+
+    // Only rewrites the aggregate when its contents change, so its mtime stays put.
+    auto write(const Batch& batch) const -> bool {
+      auto text = std::string{ "// Generated by bootstrab, do not edit.\n" };
+      for (const auto& input : batch.inputs) {
+        text += "#include \"" + input.generic_string() + "\"\n";
+      }
+
+      auto in = std::ifstream(batch.source, std::ios::in | std::ios::binary);
+      if (in && std::string(std::istreambuf_iterator<char>(in), {}) == text) {
+        return true;
+      }
+      in.close();
+
+      auto out = std::ofstream(batch.source, std::ios::out | std::ios::binary | std::ios::trunc);
+      out << text;
+      return static_cast<bool>(out);
+    }
+  };
+
+} // namespace bstb::compiler
+
+namespace bstb {
+
+// Rebuilds the running build script when it or anything it includes changed since it was
+// compiled, then execs the new binary in place. The compiler writes the list of includes
+// to a depfile next to the binary, so the first run without one always rebuilds.
+inline auto rebuild(std::string_view input, std::span<char*>&& args) -> void {
+    constexpr static CStr Rebuilt = "BSTB_REBUILT";
+
+    // A fresh binary doesn't check again, so a header dated in the future can't loop forever.
+    if (sys::env::get(Rebuilt)) {
+      sys::env::unset(Rebuilt);
+      return;
+    }
+
+    // `input` is relative to wherever the script was compiled from. Run from anywhere else,
+    // the sources can't be found, so keep running the binary we have.
+    auto ec = std::error_code{};
+    const auto source = fs::absolute(input, ec);
+    if (ec || !fs::exists(source, ec)) {
+      return;
+    }
+
+    auto target = fs::read_symlink("/proc/self/exe", ec);
+    if (ec) {
+      target = fs::absolute(args[0], ec);
+    }
+
+    // Compiling the absolute path makes the depfile list absolute paths as well. A listed
+    // header that is gone makes the binary out of date, the compiler decides if that's fine.
+    const auto depfile = fs::path(target) += ".d";
+
+    // Build scripts only need to start quickly, so skip optimization and debug info.
+    auto build = compiler::native()
       .version("c++20")
-      .input(input)
+      .opt("0")
+      .arg("-g0")
+      .arg("-pipe")
+      .input(source)
       .output(target)
-      .compile({});
+      .incremental(depfile);
+
+    if (build.up_to_date()) {
+      return;
+    }
+
+    std::cout << "Change detected. Rebuilding..." << std::endl;
+
+    auto [status, err] = build.compile({});
 
     if (status || err) {
       std::cerr << "Could not rebuild urself because: \n" << err.why() << std::endl;
       std::exit(status);
     } 
 
-    cmd(args).run({ .pipe = Pipe::Inherited() });
+    // exec skips static destructors, so write out the trace recorded so far now.
+    trace::flush();
+    sys::env::set(Rebuilt, "1");
+    sys::process::replace(target.c_str(), args.data());
 
-    std::exit(0);
+    std::cerr << "Could not restart urself because: \n" << std::strerror(errno) << std::endl;
+    std::exit(1);
   }
 
   #define REBUILD_URSELF(argc, argv) bstb::rebuild(__FILE__, std::span<char*>(argv, static_cast<size_t>(argc)))
@@ -22,4 +22,16 @@ auto main() -> int {
 
   // We can define our own stack memory by shorthand too.
   cmd<300>("echo", "Using 300 bytes of stack memory.").run(config);
+
+  // Commands built from an arena share one block of memory that is freed in one go.
+  auto arena = buffer::Arena{};
+  for (const auto* msg : { "Using", "arena", "memory." }) {
+    cmd(arena, "echo", msg).run(config);
+  }
+  arena.release();
+
+  // Commands that are fully known at compile time keep their argv in read only data.
+  using GNU = compiler::impl::GNU<buffer::Default>;
+  auto fixed = cmd<"echo", "Using a static argv with", GNU::opt<"2">()>();
+  fixed.run(config);
 }
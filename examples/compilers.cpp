@@ -38,4 +38,34 @@ auto main() -> int {
   hello_world_compiler.compile({ .verbose = true });
 
   cmd("./hello_world").run({ .pipe = Pipe::Inherited() });
+
+  // Incremental compilers write a depfile and skip the compile entirely when the
+  // output is newer than the source and every header it includes.
+  compiler::native()
+    .incremental()
+    .no_exe()
+    .input("src/a_cpp_file.cpp")
+    .output("src/a_cpp_file.o")
+    .compile({ .verbose = true });
+
+  // Big common headers can be precompiled. The PCH is built once per distinct set of
+  // flags and force included into the compile, the header is parsed as usual if it can't be used.
+  compiler::native()
+    .version("c++20")
+    .pch("../bootstrab.hpp", "src/pch")
+    .no_exe()
+    .input("src/another_cpp_file.cpp")
+    .output("src/another_cpp_file.o")
+    .compile({ .verbose = true });
+
+  // Unity builds batch many sources into a few translation units, so shared headers are
+  // parsed once per batch instead of once per file. Sources edited after their batch was
+  // built move into their own translation unit to keep later rebuilds small.
+  auto unity = compiler::Unity{ .dir = "src/unity", .batches = 2 };
+  unity.add(fs::filter("src", [](const auto& entry) { return entry.path().extension() == ".cpp"; }));
+
+  auto [objects, err] = unity.compile(compiler::native().version("c++20"), { .verbose = true });
+  if (err) {
+    std::cerr << err.why() << '\n';
+  }
 };
@@ -22,6 +22,16 @@ auto main(int argc, char** argv) -> int {
   // Comment out after first run
   embedder::cpp("src/test.txt", "src/test.hpp");
 
+  // For big assets, incbin_cpp() writes a tiny header that exposes the same `data` and
+  // `size` but lets the assembler (or #embed) read the file instead of the compiler
+  // parsing a hex array.
+  // embedder::incbin_cpp("src/test.txt", "src/test.hpp");
+
+  // Many assets can go into one pack, looked up by their path relative to the root.
+  // embedder::pack("src", fs::filter("src", [](const auto&) { return true; }), "src.pack");
+  // auto [assets, err] = Pack::Open("src.pack");
+  // auto text = assets.find("test.txt");
+
   // Prints out the embedded text
   // Uncomment after first run
   // std::cout << test::str;
@@ -0,0 +1,74 @@
+#define BSTB_IMPL
+#include "../bootstrab.hpp"
+
+#include <random>
+
+using namespace bstb;
+
+// Measures the hex encoder used by the embedder in MB of input per second and checks
+// that every kernel produces exactly the same text as the original byte loop.
+
+constexpr static size_t InputSize = 64 << 20;
+constexpr static size_t RowSize = 20;
+
+auto write_hex_reference(char*& buf, unsigned char const* data, size_t size, size_t row_size) -> void {
+  constexpr static char hex[] = "0123456789ABCDEF";
+  for (size_t i = 0; i < size; ++i) {
+    const auto byte = data[i];
+    *buf++ = '0';
+    *buf++ = 'x';
+    *buf++ = hex[(byte >> 4) & 0xF];
+    *buf++ = hex[byte & 0xF];
+    *buf++ = ',';
+    *buf++ = ' ';
+    if ((i + 1) % row_size == 0 && i != size - 1) {
+      *buf++ = '\n';
+      *buf++ = '\t';
+    }
+  }
+
+  if (*(buf - 2) == ',') {
+    *(buf - 2) = ' ';
+  }
+}
+
+template <typename Fn>
+auto bench(std::string_view name, const std::string& expected, Fn&& fn) -> void {
+  auto output = std::string(expected.size(), '\0');
+
+  const auto start = std::chrono::steady_clock::now();
+  auto* buf = output.data();
+  fn(buf);
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << name << ": " << static_cast<size_t>((InputSize >> 20) / elapsed) << " MB/s"
+            << (output == expected ? "" : " (OUTPUT MISMATCH)") << '\n';
+}
+
+auto main() -> int {
+  auto input = std::vector<unsigned char>(InputSize);
+  auto rng = std::mt19937_64{ 42 };
+  std::generate(input.begin(), input.end(), [&] { return static_cast<unsigned char>(rng()); });
+
+  const auto rows = (InputSize + RowSize - 1) / RowSize;
+  auto expected = std::string(InputSize * 6 + rows * 2, '\0');
+  auto* end = expected.data();
+  write_hex_reference(end, input.data(), input.size(), RowSize);
+  expected.resize(end - expected.data());
+
+  bench("byte loop", expected, [&](char*& buf) {
+    write_hex_reference(buf, input.data(), input.size(), RowSize);
+  });
+
+  bench("table", expected, [&](char*& buf) {
+    embedder::write_hex_impl(buf, input.data(), input.size(), RowSize, 1, embedder::write_hex_scalar_impl);
+  });
+
+  bench("dispatched", expected, [&](char*& buf) {
+    embedder::write_hex_impl(buf, input.data(), input.size(), RowSize);
+  });
+
+  bench("parallel", expected, [&](char*& buf) {
+    embedder::write_hex_impl(buf, input.data(), input.size(), RowSize, sys::process::cpu_count());
+  });
+}
@@ -0,0 +1,38 @@
+#define BSTB_IMPL
+#include "../bootstrab.hpp"
+
+using namespace bstb;
+
+auto main() -> int {
+  auto graph = Graph{};
+
+  // Targets are commands, compilers or plain functions. Each one starts as soon as the
+  // targets it depends on are done, not when some barrier further up is reached.
+  const auto embed = graph.add("embed", Graph::Action{ [] {
+    return embedder::cpp("src/test.txt", "src/test.hpp");
+  } });
+  // Declaring the asset matters most for embedder::incbin_cpp, whose header only names it,
+  // so compiler depfiles never see the asset itself.
+  graph.input(embed, "src/test.txt").output(embed, "src/test.hpp");
+
+  const auto a = graph.add("a", compiler::native().version("c++20").no_exe().input("src/a_cpp_file.cpp").output("src/a_cpp_file.o"));
+  const auto b = graph.add("b", compiler::native().version("c++20").no_exe().input("src/another_cpp_file.cpp").output("src/another_cpp_file.o"));
+
+  // Reading another target's output is enough to depend on it.
+  graph.input(a, "src/test.hpp");
+
+  const auto link = graph.add("link", compiler::native().input("src/a_cpp_file.o").input("src/another_cpp_file.o").output("src/app"));
+  graph.depends(link, a).depends(link, b);
+
+  auto [states, err] = graph.run();
+  if (err) {
+    std::cerr << err.why() << '\n';
+    return 1;
+  }
+
+  // Targets depending on a failed one are skipped instead of run.
+  constexpr static CStr names[] = { "pending", "done", "up to date", "failed", "skipped" };
+  for (size_t node = 0; node < states.size(); ++node) {
+    std::cout << graph.targets[node].name << ": " << names[static_cast<size_t>(states[node])] << '\n';
+  }
+}
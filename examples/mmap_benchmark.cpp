@@ -0,0 +1,95 @@
+#define BSTB_IMPL
+#include "../bootstrab.hpp"
+
+#include <random>
+
+extern "C" {
+  #include <sys/resource.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+}
+
+using namespace bstb;
+
+// Runs the embedder's read -> encode -> write path over a large file with different
+// mapping hints and reports throughput along with the page faults it took.
+
+constexpr static CStr InputPath = "mmap_benchmark.bin";
+constexpr static CStr OutputPath = "mmap_benchmark.hpp";
+constexpr static size_t InputSize = 256 << 20;
+constexpr static size_t RowSize = 20;
+
+auto faults() -> std::pair<long, long> {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return { usage.ru_minflt, usage.ru_majflt };
+}
+
+// Writes back and drops the file's pages from the page cache, so the next read faults
+// them in from disk.
+auto evict(CStr path) -> bool {
+  const auto fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  const auto ok = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close(fd);
+  return ok;
+}
+
+auto bench(std::string_view name, MMap::Options read_options, MMap::Options write_options) -> void {
+  const auto [minor_before, major_before] = faults();
+  const auto start = std::chrono::steady_clock::now();
+
+  {
+    auto [input, input_err] = MMap::Read(InputPath, read_options);
+    if (input_err) {
+      std::cerr << input_err.why() << '\n';
+      return;
+    }
+
+    const auto rows = (input.size + RowSize - 1) / RowSize;
+    auto [output, output_err] = MMap::Write(OutputPath, input.size * 6 + rows * 2, write_options);
+    if (output_err) {
+      std::cerr << output_err.why() << '\n';
+      return;
+    }
+
+    auto* buf = static_cast<char*>(output.data);
+    embedder::write_hex_impl(buf, static_cast<unsigned char const*>(input.data), input.size, RowSize);
+    output.resize(buf - static_cast<char*>(output.data));
+    output.sync(false);
+  }
+
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const auto [minor_after, major_after] = faults();
+
+  std::cout << name << ": " << static_cast<size_t>((InputSize >> 20) / elapsed) << " MB/s, "
+            << (minor_after - minor_before) << " minor / " << (major_after - major_before) << " major faults\n";
+}
+
+auto main() -> int {
+  {
+    auto [input, err] = MMap::Write(InputPath, InputSize);
+    if (err) {
+      std::cerr << err.why() << '\n';
+      return 1;
+    }
+
+    auto rng = std::mt19937_64{ 42 };
+    auto bytes = input.bytes();
+    std::generate(bytes.begin(), bytes.end(), [&] { return static_cast<unsigned char>(rng()); });
+  }
+
+  if (!evict(InputPath)) {
+    std::cerr << "Failed to drop " << InputPath << " from the page cache, the cold run is warm.\n";
+  }
+  bench("cold", {}, {});
+  bench("default", {}, {});
+  bench("sequential", { .advice = MMap::Sequential }, {});
+  bench("populate", { .populate = true }, { .populate = true });
+  bench("huge pages", { .advice = MMap::Sequential, .huge_pages = true }, { .huge_pages = true });
+
+  fs::remove(InputPath);
+  fs::remove(OutputPath);
+}
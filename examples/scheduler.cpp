@@ -0,0 +1,34 @@
+#define BSTB_IMPL
+#include "../bootstrab.hpp"
+
+using namespace bstb;
+
+auto main() -> int {
+  const auto config = Config{
+      .pipe = Pipe::Inherited(),
+  };
+
+  // Writes a timeline of every command to open in Perfetto once the program exits.
+  // Setting BSTB_TRACE=<path> does the same without touching the build script.
+  trace::start("scheduler.trace.json");
+
+  // Only `jobs` processes run at the same time, by default one per online cpu.
+  // Durations remembers how long every command took, so the next run starts the
+  // slowest ones first. It also remembers their peak memory, so with a budget the
+  // scheduler holds back jobs that would not fit and runs smaller ones in the meantime.
+  auto durations = Durations::Load();
+  auto scheduler = Scheduler{ .jobs = 2, .durations = &durations, .memory_budget_kb = Scheduler::MemoryLimit() / 2 };
+
+  for (const auto* msg : { "one", "two", "three", "four", "five" }) {
+    scheduler.push(cmd("sh", "-c", std::string{"sleep 1; echo "} + msg), config);
+  }
+
+  // Compilers can be queued directly as well.
+  scheduler.push(compiler::native().version("c++20").input("hello_world.cpp").output("hello_world"));
+
+  const auto results = scheduler.run();
+  for (size_t id = 0; id < results.size(); ++id) {
+    const auto& [status, err] = results[id];
+    std::cout << "Job " << id << ": " << (err ? err.why() : "exited with ") << status << '\n';
+  }
+}
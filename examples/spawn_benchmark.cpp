@@ -0,0 +1,42 @@
+#define BSTB_IMPL
+#include "../bootstrab.hpp"
+
+using namespace bstb;
+
+// Spawns `true` over and over, once through a fresh posix_spawnp setup per launch
+// (how bootstrab used to spawn) and once through Command::run.
+
+constexpr static auto Spawns = 2000;
+
+auto spawn_fresh(char* const* args) -> void {
+  posix_spawn_file_actions_t file_actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&file_actions);
+  posix_spawnattr_init(&attr);
+
+  sys::process::Pid pid;
+  if (posix_spawnp(&pid, args[0], &file_actions, &attr, args, sys::environ) == 0) {
+    sys::process::wait(pid);
+  }
+
+  posix_spawn_file_actions_destroy(&file_actions);
+  posix_spawnattr_destroy(&attr);
+}
+
+template <typename Fn>
+auto bench(std::string_view name, Fn&& fn) -> void {
+  const auto start = std::chrono::steady_clock::now();
+  for (auto i = 0; i < Spawns; ++i) {
+    fn();
+  }
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << ": " << static_cast<size_t>(Spawns / elapsed) << " spawns/s\n";
+}
+
+auto main() -> int {
+  auto command = cmd("true");
+  auto* args = command.buffer.exec_args();
+
+  bench("posix_spawnp per launch", [&] { spawn_fresh(args); });
+  bench("Command::run", [&] { command.run({ .pipe = Pipe::Inherited() }); });
+}
@@ -15,11 +15,25 @@ auto main() -> int {
       .verbose = true,
   };
 
-  auto future = TaskList{ .tasks = {
-      clone_into("/tmp/bootstrab1").run_async(config),
-      clone_into("/tmp/bootstrab2").run_async(config),
-      clone_into("/tmp/bootstrab3").run_async(config),
-  }};
+  // Futures own their process' capture pipes, so they are moved into the list.
+  auto tasks = TaskList{};
+  for (const auto* path : { "/tmp/bootstrab1", "/tmp/bootstrab2", "/tmp/bootstrab3" }) {
+    auto [future, err] = clone_into(path).run_async(config);
+    if (err) {
+      std::cerr << err.why() << '\n';
+      continue;
+    }
+    tasks.push(std::move(future));
+  }
 
-  future.wait();
+  // wait_any() wakes up as soon as any task exits, no polling involved.
+  while (!tasks.empty()) {
+    auto [finished, err] = tasks.wait_any();
+    if (err) {
+      std::cerr << err.why() << '\n';
+      break;
+    }
+    std::cout << "Task " << finished.future.pid << " exited with " << finished.status
+              << " using " << finished.usage.max_rss_kb << " KB\n";
+  }
 }